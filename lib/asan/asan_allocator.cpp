@@ -1121,6 +1121,26 @@ void LsanMetadata::set_tag(ChunkTag value) {
   m->lsan_tag = value;
 }
 
+bool LsanMetadata::compare_exchange_tag(ChunkTag cmp, ChunkTag xchg) {
+  // lsan_tag shares the first 32 bits of the header with chunk_state and
+  // other fields that do not change while the world is stopped, so compare
+  // and swap the whole word.
+  __asan::AsanChunk *m = reinterpret_cast<__asan::AsanChunk *>(metadata_);
+  atomic_uint32_t *word = reinterpret_cast<atomic_uint32_t *>(m);
+  u32 old_word = atomic_load_relaxed(word);
+  alignas(__asan::ChunkHeader) char buf[sizeof(__asan::ChunkHeader)];
+  internal_memcpy(buf, m, sizeof(buf));
+  internal_memcpy(buf, &old_word, sizeof(old_word));
+  __asan::ChunkHeader *tmp = reinterpret_cast<__asan::ChunkHeader *>(buf);
+  if (tmp->lsan_tag != cmp)
+    return false;
+  tmp->lsan_tag = xchg;
+  u32 new_word;
+  internal_memcpy(&new_word, buf, sizeof(new_word));
+  return atomic_compare_exchange_strong(word, &old_word, new_word,
+                                        memory_order_relaxed);
+}
+
 uptr LsanMetadata::requested_size() const {
   __asan::AsanChunk *m = reinterpret_cast<__asan::AsanChunk *>(metadata_);
   return m->UsedSize();
@@ -1138,6 +1158,10 @@ void ForEachChunk(ForEachChunkCallback callback, void *arg) {
   __asan::get_allocator().ForEachChunk(callback, arg);
 }
 
+void ForEachChunkBatch(ForEachChunkBatchCallback callback, void *arg) {
+  __asan::get_allocator().ForEachChunkBatch(callback, arg);
+}
+
 IgnoreObjectResult IgnoreObjectLocked(const void *p) {
   uptr addr = reinterpret_cast<uptr>(p);
   __asan::AsanChunk *m = __asan::instance.GetAsanChunkByAddr(addr);
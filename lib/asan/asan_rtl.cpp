@@ -476,6 +476,7 @@ static void AsanInitInternal() {
   if (CAN_SANITIZE_LEAKS) {
     __lsan::InitCommonLsan();
     InstallAtExitCheckLeaks();
+    __lsan::MaybeStartPeriodicLeakChecks();
   }
 
 #if CAN_SANITIZE_UB
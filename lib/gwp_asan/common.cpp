@@ -36,6 +36,7 @@ const char *ErrorToString(const Error &E) {
 
 constexpr size_t AllocationMetadata::kStackFrameStorageBytes;
 constexpr size_t AllocationMetadata::kMaxTraceLengthToCollect;
+constexpr size_t AllocatorState::kMaxSlotBuckets;
 
 void AllocationMetadata::RecordAllocation(uintptr_t AllocAddr,
                                           size_t AllocSize) {
@@ -54,7 +55,7 @@ void AllocationMetadata::RecordDeallocation() {
 }
 
 void AllocationMetadata::CallSiteInfo::RecordBacktrace(
-    options::Backtrace_t Backtrace) {
+    options::Backtrace_t Backtrace, const CallSiteInfo *Base) {
   TraceSize = 0;
   if (!Backtrace)
     return;
@@ -67,28 +68,98 @@ void AllocationMetadata::CallSiteInfo::RecordBacktrace(
   // the number of frames that are in the buffer.
   if (BacktraceLength > kMaxTraceLengthToCollect)
     BacktraceLength = kMaxTraceLengthToCollect;
-  TraceSize =
-      compression::pack(UncompressedBuffer, BacktraceLength, CompressedTrace,
-                        AllocationMetadata::kStackFrameStorageBytes);
+  if (!Base) {
+    TraceSize =
+        compression::pack(UncompressedBuffer, BacktraceLength, CompressedTrace,
+                          AllocationMetadata::kStackFrameStorageBytes);
+    return;
+  }
+
+  uintptr_t BaseBuffer[kMaxTraceLengthToCollect];
+  size_t BaseLength =
+      compression::unpack(Base->CompressedTrace, Base->TraceSize, BaseBuffer,
+                          kMaxTraceLengthToCollect);
+  TraceSize = compression::packWithBase(
+      UncompressedBuffer, BacktraceLength, BaseBuffer, BaseLength,
+      CompressedTrace, AllocationMetadata::kStackFrameStorageBytes);
+}
+
+static size_t getNumSlotBuckets(const AllocatorState *State) {
+  return State->NumSlotBuckets ? State->NumSlotBuckets : 1;
 }
 
-size_t AllocatorState::maximumAllocationSize() const { return PageSize; }
+static size_t getSlotBucketEnd(const AllocatorState *State, size_t Bucket) {
+  return Bucket + 1 < getNumSlotBuckets(State)
+             ? State->SlotBucketStart[Bucket + 1]
+             : State->MaxSimultaneousAllocations;
+}
+
+// Returns the distance between two slots of the bucket, i.e. the size of a
+// slot and its trailing guard page.
+static size_t getSlotStride(const AllocatorState *State, size_t Bucket) {
+  return (State->PageSize << Bucket) + State->PageSize;
+}
+
+// Returns the bucket of the N-th slot, and sets `BucketAddr` to the address of
+// the first slot of that bucket.
+static size_t slotToBucket(const AllocatorState *State, size_t N,
+                           uintptr_t *BucketAddr) {
+  *BucketAddr = State->GuardedPagePool + State->PageSize;
+  size_t Bucket = 0;
+  for (; Bucket + 1 < getNumSlotBuckets(State) &&
+         N >= getSlotBucketEnd(State, Bucket);
+       ++Bucket)
+    *BucketAddr += (getSlotBucketEnd(State, Bucket) -
+                    State->SlotBucketStart[Bucket]) *
+                   getSlotStride(State, Bucket);
+  return Bucket;
+}
+
+size_t AllocatorState::maximumAllocationSize() const {
+  return PageSize << (getNumSlotBuckets(this) - 1);
+}
 
 uintptr_t AllocatorState::slotToAddr(size_t N) const {
-  return GuardedPagePool + (PageSize * (1 + N)) + (maximumAllocationSize() * N);
+  uintptr_t BucketAddr;
+  size_t Bucket = slotToBucket(this, N, &BucketAddr);
+  return BucketAddr +
+         (N - SlotBucketStart[Bucket]) * getSlotStride(this, Bucket);
 }
 
-bool AllocatorState::isGuardPage(uintptr_t Ptr) const {
-  assert(pointerIsMine(reinterpret_cast<void *>(Ptr)));
-  size_t PageOffsetFromPoolStart = (Ptr - GuardedPagePool) / PageSize;
-  size_t PagesPerSlot = maximumAllocationSize() / PageSize;
-  return (PageOffsetFromPoolStart % (PagesPerSlot + 1)) == 0;
+size_t AllocatorState::slotSize(size_t N) const {
+  uintptr_t BucketAddr;
+  return PageSize << slotToBucket(this, N, &BucketAddr);
 }
 
-static size_t addrToSlot(const AllocatorState *State, uintptr_t Ptr) {
-  size_t ByteOffsetFromPoolStart = Ptr - State->GuardedPagePool;
-  return ByteOffsetFromPoolStart /
-         (State->maximumAllocationSize() + State->PageSize);
+// Returns the slot that contains the provided pointer, or that is followed by
+// the guard page that contains it, and sets `IsGuardPage` accordingly. The
+// pointer must be past the first guard page of the pool.
+static size_t addrToSlot(const AllocatorState *State, uintptr_t Ptr,
+                         bool *IsGuardPage) {
+  uintptr_t BucketAddr = State->GuardedPagePool + State->PageSize;
+  size_t Bucket = 0;
+  for (; Bucket + 1 < getNumSlotBuckets(State); ++Bucket) {
+    uintptr_t BucketEnd = BucketAddr + (getSlotBucketEnd(State, Bucket) -
+                                        State->SlotBucketStart[Bucket]) *
+                                           getSlotStride(State, Bucket);
+    if (Ptr < BucketEnd)
+      break;
+    BucketAddr = BucketEnd;
+  }
+  size_t ByteOffsetFromBucketStart = Ptr - BucketAddr;
+  size_t Stride = getSlotStride(State, Bucket);
+  *IsGuardPage =
+      ByteOffsetFromBucketStart % Stride >= (State->PageSize << Bucket);
+  return State->SlotBucketStart[Bucket] + ByteOffsetFromBucketStart / Stride;
+}
+
+bool AllocatorState::isGuardPage(uintptr_t Ptr) const {
+  assert(pointerIsMine(reinterpret_cast<void *>(Ptr)));
+  if (Ptr < GuardedPagePool + PageSize)
+    return true;
+  bool IsGuardPage;
+  addrToSlot(this, Ptr, &IsGuardPage);
+  return IsGuardPage;
 }
 
 size_t AllocatorState::getNearestSlot(uintptr_t Ptr) const {
@@ -97,12 +168,15 @@ size_t AllocatorState::getNearestSlot(uintptr_t Ptr) const {
   if (Ptr > GuardedPagePoolEnd - PageSize)
     return MaxSimultaneousAllocations - 1;
 
-  if (!isGuardPage(Ptr))
-    return addrToSlot(this, Ptr);
+  bool IsGuardPage;
+  size_t Slot = addrToSlot(this, Ptr, &IsGuardPage);
+  if (!IsGuardPage)
+    return Slot;
 
+  // The guard page is between `Slot` and the next one.
   if (Ptr % PageSize <= PageSize / 2)
-    return addrToSlot(this, Ptr - PageSize); // Round down.
-  return addrToSlot(this, Ptr + PageSize);   // Round up.
+    return Slot;   // Round down.
+  return Slot + 1; // Round up.
 }
 
 } // namespace gwp_asan
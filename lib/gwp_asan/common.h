@@ -35,7 +35,7 @@ struct AllocatorVersionMagic {
   uint8_t Magic[4] = {};
   // Update the version number when the AllocatorState or AllocationMetadata
   // change.
-  static constexpr uint16_t kAllocatorVersion = 1;
+  static constexpr uint16_t kAllocatorVersion = 3;
   uint16_t Version = 0;
   uint16_t Reserved = 0;
 };
@@ -75,8 +75,11 @@ struct AllocationMetadata {
   void RecordDeallocation();
 
   struct CallSiteInfo {
-    // Record the current backtrace to this callsite.
-    void RecordBacktrace(options::Backtrace_t Backtrace);
+    // Record the current backtrace to this callsite. If `Base` is provided,
+    // the backtrace is stored relative to the backtrace of `Base`, see
+    // compression::packWithBase().
+    void RecordBacktrace(options::Backtrace_t Backtrace,
+                         const CallSiteInfo *Base = nullptr);
 
     // The compressed backtrace to the allocation/deallocation.
     uint8_t CompressedTrace[kStackFrameStorageBytes];
@@ -94,6 +97,8 @@ struct AllocationMetadata {
   size_t RequestedSize = 0;
 
   CallSiteInfo AllocationTrace;
+  // Stored relative to AllocationTrace, as they usually share their outermost
+  // frames.
   CallSiteInfo DeallocationTrace;
 
   // Whether this allocation has been deallocated yet.
@@ -117,6 +122,9 @@ struct AllocatorState {
   // Returns the address of the N-th guarded slot.
   uintptr_t slotToAddr(size_t N) const;
 
+  // Returns the size of the N-th guarded slot.
+  size_t slotSize(size_t N) const;
+
   // Returns the largest allocation that is supported by this pool.
   size_t maximumAllocationSize() const;
 
@@ -143,6 +151,14 @@ struct AllocatorState {
   // these values and terminate the process.
   Error FailureType = Error::UNKNOWN;
   uintptr_t FailureAddress = 0;
+
+  // The slots are grouped in buckets by size. The slots of bucket B are
+  // (1 << B) pages each, and start at slot SlotBucketStart[B]. In the pool,
+  // every slot is followed by a guard page, and the slots of bucket B follow
+  // those of bucket B - 1. Zero buckets means that all slots are one page.
+  static constexpr size_t kMaxSlotBuckets = 8;
+  size_t NumSlotBuckets = 0;
+  size_t SlotBucketStart[kMaxSlotBuckets] = {};
 };
 
 // Below are various compile-time checks that the layout of the internal
@@ -157,22 +173,22 @@ struct AllocatorState {
 static_assert(offsetof(AllocatorState, VersionMagic) == 0, "");
 static_assert(sizeof(AllocatorVersionMagic) == 8, "");
 #if defined(__x86_64__)
-static_assert(sizeof(AllocatorState) == 56, "");
+static_assert(sizeof(AllocatorState) == 128, "");
 static_assert(offsetof(AllocatorState, FailureAddress) == 48, "");
 static_assert(sizeof(AllocationMetadata) == 568, "");
 static_assert(offsetof(AllocationMetadata, IsDeallocated) == 560, "");
 #elif defined(__aarch64__)
-static_assert(sizeof(AllocatorState) == 56, "");
+static_assert(sizeof(AllocatorState) == 128, "");
 static_assert(offsetof(AllocatorState, FailureAddress) == 48, "");
 static_assert(sizeof(AllocationMetadata) == 568, "");
 static_assert(offsetof(AllocationMetadata, IsDeallocated) == 560, "");
 #elif defined(__i386__)
-static_assert(sizeof(AllocatorState) == 32, "");
+static_assert(sizeof(AllocatorState) == 68, "");
 static_assert(offsetof(AllocatorState, FailureAddress) == 28, "");
 static_assert(sizeof(AllocationMetadata) == 548, "");
 static_assert(offsetof(AllocationMetadata, IsDeallocated) == 544, "");
 #elif defined(__arm__)
-static_assert(sizeof(AllocatorState) == 32, "");
+static_assert(sizeof(AllocatorState) == 68, "");
 static_assert(offsetof(AllocatorState, FailureAddress) == 28, "");
 static_assert(sizeof(AllocationMetadata) == 560, "");
 static_assert(offsetof(AllocationMetadata, IsDeallocated) == 552, "");
@@ -74,6 +74,15 @@ __gwp_asan_diagnose_error(const gwp_asan::AllocatorState *State,
     return Error::USE_AFTER_FREE;
   }
 
+  // The pages of a multi-page slot that the allocation doesn't use are
+  // inaccessible too, and guard the other side of the allocation.
+  if (SlotMeta->Addr) {
+    if (ErrorPtr < SlotMeta->Addr)
+      return Error::BUFFER_UNDERFLOW;
+    if (ErrorPtr >= SlotMeta->Addr + SlotMeta->RequestedSize)
+      return Error::BUFFER_OVERFLOW;
+  }
+
   // If we have reached here, the error is still unknown.
   return Error::UNKNOWN;
 }
@@ -138,11 +147,16 @@ uint64_t __gwp_asan_get_deallocation_thread_id(
 size_t __gwp_asan_get_deallocation_trace(
     const gwp_asan::AllocationMetadata *AllocationMeta, uintptr_t *Buffer,
     size_t BufferLen) {
+  uintptr_t BaseBuffer[AllocationMetadata::kMaxTraceLengthToCollect];
+  size_t BaseLength = gwp_asan::compression::unpack(
+      AllocationMeta->AllocationTrace.CompressedTrace,
+      AllocationMeta->AllocationTrace.TraceSize, BaseBuffer,
+      AllocationMetadata::kMaxTraceLengthToCollect);
   uintptr_t UncompressedBuffer[AllocationMetadata::kMaxTraceLengthToCollect];
-  size_t UnpackedLength = gwp_asan::compression::unpack(
+  size_t UnpackedLength = gwp_asan::compression::unpackWithBase(
       AllocationMeta->DeallocationTrace.CompressedTrace,
-      AllocationMeta->DeallocationTrace.TraceSize, UncompressedBuffer,
-      AllocationMetadata::kMaxTraceLengthToCollect);
+      AllocationMeta->DeallocationTrace.TraceSize, BaseBuffer, BaseLength,
+      UncompressedBuffer, AllocationMetadata::kMaxTraceLengthToCollect);
   if (UnpackedLength < BufferLen)
     BufferLen = UnpackedLength;
   memcpy(Buffer, UncompressedBuffer, BufferLen * sizeof(*Buffer));
@@ -35,6 +35,16 @@ uintptr_t getPageAddr(uintptr_t Ptr, uintptr_t PageSize) {
 }
 
 bool isPowerOfTwo(uintptr_t X) { return (X & (X - 1)) == 0; }
+
+// Size classes for adaptive sampling: powers of two from 16 bytes, with all
+// larger sizes in the last class.
+size_t getSizeClass(size_t Size, size_t NumSizeClasses) {
+  size_t Class = 0;
+  for (size_t Bound = 16; Size > Bound && Class + 1 < NumSizeClasses;
+       Bound <<= 1)
+    ++Class;
+  return Class;
+}
 } // anonymous namespace
 
 // Gets the singleton implementation of this class. Thread-compatible until
@@ -55,6 +65,13 @@ void GuardedPoolAllocator::init(const options::Options &Opts) {
   Check(Opts.SampleRate < (1 << 30), "GWP-ASan Error: SampleRate is >= 2^30.");
   Check(Opts.MaxSimultaneousAllocations >= 0,
         "GWP-ASan Error: MaxSimultaneousAllocations is < 0.");
+  Check(Opts.MaximumAllocationSize >= 0,
+        "GWP-ASan Error: MaximumAllocationSize is < 0.");
+  Check(Opts.TargetSampledAllocationsPerSecond >= 0,
+        "GWP-ASan Error: TargetSampledAllocationsPerSecond is < 0.");
+  Check(Opts.TargetPoolOccupancyPercent > 0 &&
+            Opts.TargetPoolOccupancyPercent <= 100,
+        "GWP-ASan Error: TargetPoolOccupancyPercent is not in (0, 100].");
 
   SingletonPtr = this;
   Backtrace = Opts.Backtrace;
@@ -73,9 +90,34 @@ void GuardedPoolAllocator::init(const options::Options &Opts) {
   assert((PageSize & (PageSize - 1)) == 0);
   State.PageSize = PageSize;
 
+  // Split the slots into buckets of 1, 2, 4, ... pages, until allocations of
+  // MaximumAllocationSize bytes fit. Each bucket gets about half as many slots
+  // as the previous one, but at least one, and the first bucket gets the rest.
+  size_t NumBuckets = 1;
+  while (NumBuckets < AllocatorState::kMaxSlotBuckets &&
+         NumBuckets < State.MaxSimultaneousAllocations &&
+         (PageSize << (NumBuckets - 1)) <
+             static_cast<size_t>(Opts.MaximumAllocationSize))
+    ++NumBuckets;
+  size_t SlotsLeft = State.MaxSimultaneousAllocations;
+  for (size_t Bucket = NumBuckets - 1; Bucket > 0; --Bucket) {
+    size_t BucketSlots = State.MaxSimultaneousAllocations >> (Bucket + 1);
+    if (BucketSlots == 0)
+      BucketSlots = 1;
+    // Leave at least one slot for each smaller bucket.
+    if (BucketSlots > SlotsLeft - Bucket)
+      BucketSlots = SlotsLeft - Bucket;
+    SlotsLeft -= BucketSlots;
+    State.SlotBucketStart[Bucket] = SlotsLeft;
+  }
+  State.SlotBucketStart[0] = 0;
+  State.NumSlotBuckets = NumBuckets;
+
+  // The pool ends with the guard page of the last slot, which is where the
+  // slot after it would start.
   size_t PoolBytesRequired =
-      PageSize * (1 + State.MaxSimultaneousAllocations) +
-      State.MaxSimultaneousAllocations * State.maximumAllocationSize();
+      State.slotToAddr(State.MaxSimultaneousAllocations) -
+      State.GuardedPagePool;
   assert(PoolBytesRequired % PageSize == 0);
   void *GuardedPoolMemory = reserveGuardedPool(PoolBytesRequired);
 
@@ -90,12 +132,30 @@ void GuardedPoolAllocator::init(const options::Options &Opts) {
   FreeSlots =
       reinterpret_cast<size_t *>(map(BytesRequired, kGwpAsanFreeSlotsName));
 
-  // Multiply the sample rate by 2 to give a good, fast approximation for (1 /
-  // SampleRate) chance of sampling.
-  if (Opts.SampleRate != 1)
-    AdjustedSampleRatePlusOne = static_cast<uint32_t>(Opts.SampleRate) * 2 + 1;
-  else
-    AdjustedSampleRatePlusOne = 2;
+  // Split the free slots into shards of at least kMinSlotsPerShard slots.
+  NumShards = State.MaxSimultaneousAllocations / kMinSlotsPerShard;
+  if (NumShards == 0)
+    NumShards = 1;
+  if (NumShards > kMaxSlotShards)
+    NumShards = kMaxSlotShards;
+  SlotsPerShard =
+      (State.MaxSimultaneousAllocations + NumShards - 1) / NumShards;
+  NumShards =
+      (State.MaxSimultaneousAllocations + SlotsPerShard - 1) / SlotsPerShard;
+  for (size_t i = 0; i < NumShards; ++i)
+    Shards[i].FreeSlots = FreeSlots + i * SlotsPerShard;
+
+  setSampleRate(static_cast<uint32_t>(Opts.SampleRate));
+  TargetSamplesPerSecond =
+      static_cast<uint32_t>(Opts.TargetSampledAllocationsPerSecond);
+  if (TargetSamplesPerSecond) {
+    TargetOccupiedSlots = State.MaxSimultaneousAllocations *
+                          Opts.TargetPoolOccupancyPercent / 100;
+    if (TargetOccupiedSlots == 0)
+      TargetOccupiedSlots = 1;
+    SizeClassWeighting = Opts.SizeClassWeighting;
+    SampleWindowStartNs = getPlatformMonotonicTimeNs();
+  }
 
   initPRNG();
   getThreadLocals()->NextSampleCounter =
@@ -111,6 +171,8 @@ void GuardedPoolAllocator::init(const options::Options &Opts) {
 }
 
 void GuardedPoolAllocator::disable() {
+  for (SlotShard &Shard : Shards)
+    Shard.Mu.lock();
   PoolMutex.lock();
   BacktraceMutex.lock();
 }
@@ -118,6 +180,8 @@ void GuardedPoolAllocator::disable() {
 void GuardedPoolAllocator::enable() {
   PoolMutex.unlock();
   BacktraceMutex.unlock();
+  for (SlotShard &Shard : Shards)
+    Shard.Mu.unlock();
 }
 
 void GuardedPoolAllocator::iterate(void *Base, size_t Size, iterate_callback Cb,
@@ -212,27 +276,39 @@ void *GuardedPoolAllocator::allocate(size_t Size, size_t Alignment) {
   size_t BackingSize = getRequiredBackingSize(Size, Alignment, State.PageSize);
   if (BackingSize > State.maximumAllocationSize())
     return nullptr;
+  size_t Bucket = 0;
+  while ((State.PageSize << Bucket) < BackingSize)
+    ++Bucket;
 
   // Protect against recursivity.
   if (getThreadLocals()->RecursiveGuard)
     return nullptr;
   ScopedRecursiveGuard SRG;
 
-  size_t Index;
-  {
+  if (TargetSamplesPerSecond) {
     ScopedLock L(PoolMutex);
-    Index = reserveSlot();
+    if (!sizeClassAccepts(Size))
+      return nullptr;
   }
 
+  size_t Index = reserveSlot(Bucket);
   if (Index == kInvalidSlotID)
     return nullptr;
 
+  if (TargetSamplesPerSecond) {
+    __atomic_fetch_add(&NumAllocatedSlots, 1, __ATOMIC_RELAXED);
+    ScopedLock L(PoolMutex);
+    recordSample(Size);
+  }
+
   uintptr_t SlotStart = State.slotToAddr(Index);
   AllocationMetadata *Meta = addrToMetadata(SlotStart);
-  uintptr_t SlotEnd = State.slotToAddr(Index) + State.maximumAllocationSize();
+  uintptr_t SlotEnd = SlotStart + State.slotSize(Index);
   uintptr_t UserPtr;
   // Randomly choose whether to left-align or right-align the allocation, and
-  // then apply the necessary adjustments to get an aligned pointer.
+  // then apply the necessary adjustments to get an aligned pointer. Either way,
+  // the allocation is against one of the guard pages of the slot, and the
+  // unused pages of the slot guard the other side.
   if (getRandomUnsigned32() % 2 == 0)
     UserPtr = alignUp(SlotStart, Alignment);
   else
@@ -273,6 +349,8 @@ void GuardedPoolAllocator::trapOnAddress(uintptr_t Address, Error E) {
 
 void GuardedPoolAllocator::stop() {
   getThreadLocals()->RecursiveGuard = true;
+  for (SlotShard &Shard : Shards)
+    Shard.Mu.tryLock();
   PoolMutex.tryLock();
 }
 
@@ -291,8 +369,9 @@ void GuardedPoolAllocator::deallocate(void *Ptr) {
   // Intentionally scope the mutex here, so that other threads can access the
   // pool during the expensive markInaccessible() call.
   {
-    ScopedLock L(PoolMutex);
+    ScopedLock L(getShard(Slot).Mu);
     if (Meta->IsDeallocated) {
+      ScopedLock EL(PoolMutex);
       trapOnAddress(UPtr, Error::DOUBLE_FREE);
     }
 
@@ -306,22 +385,25 @@ void GuardedPoolAllocator::deallocate(void *Ptr) {
     if (!getThreadLocals()->RecursiveGuard) {
       ScopedRecursiveGuard SRG;
       ScopedLock UL(BacktraceMutex);
-      Meta->DeallocationTrace.RecordBacktrace(Backtrace);
+      Meta->DeallocationTrace.RecordBacktrace(Backtrace,
+                                              &Meta->AllocationTrace);
     }
   }
 
   deallocateInGuardedPool(reinterpret_cast<void *>(SlotStart),
-                          State.maximumAllocationSize());
+                          State.slotSize(Slot));
 
-  // And finally, lock again to release the slot back into the pool.
-  ScopedLock L(PoolMutex);
+  // And finally, release the slot back into the pool.
+  if (TargetSamplesPerSecond)
+    __atomic_fetch_sub(&NumAllocatedSlots, 1, __ATOMIC_RELAXED);
   freeSlot(Slot);
 }
 
 size_t GuardedPoolAllocator::getSize(const void *Ptr) {
   assert(pointerIsMine(Ptr));
-  ScopedLock L(PoolMutex);
-  AllocationMetadata *Meta = addrToMetadata(reinterpret_cast<uintptr_t>(Ptr));
+  const uintptr_t UPtr = reinterpret_cast<uintptr_t>(Ptr);
+  ScopedLock L(getShard(State.getNearestSlot(UPtr)).Mu);
+  AllocationMetadata *Meta = addrToMetadata(UPtr);
   assert(Meta->Addr == reinterpret_cast<uintptr_t>(Ptr));
   return Meta->RequestedSize;
 }
@@ -330,24 +412,180 @@ AllocationMetadata *GuardedPoolAllocator::addrToMetadata(uintptr_t Ptr) const {
   return &Metadata[State.getNearestSlot(Ptr)];
 }
 
-size_t GuardedPoolAllocator::reserveSlot() {
-  // Avoid potential reuse of a slot before we have made at least a single
-  // allocation in each slot. Helps with our use-after-free detection.
-  if (NumSampledAllocations < State.MaxSimultaneousAllocations)
-    return NumSampledAllocations++;
+size_t GuardedPoolAllocator::reserveSlot(size_t MinBucket) {
+  // Prefer the smallest slots that fit, so that the larger ones are left for
+  // larger allocations.
+  for (size_t Bucket = MinBucket; Bucket < State.NumSlotBuckets; ++Bucket) {
+    const size_t BucketBegin = State.SlotBucketStart[Bucket];
+    const size_t BucketEnd = Bucket + 1 < State.NumSlotBuckets
+                                 ? State.SlotBucketStart[Bucket + 1]
+                                 : State.MaxSimultaneousAllocations;
+
+    // Avoid potential reuse of a slot before we have made at least a single
+    // allocation in each slot. Helps with our use-after-free detection.
+    size_t *NumSampled = &NumSampledAllocations[Bucket];
+    if (__atomic_load_n(NumSampled, __ATOMIC_RELAXED) <
+        BucketEnd - BucketBegin) {
+      size_t SlotIndex =
+          BucketBegin + __atomic_fetch_add(NumSampled, 1, __ATOMIC_RELAXED);
+      if (SlotIndex < BucketEnd)
+        return SlotIndex;
+    }
 
-  if (FreeSlotsLength == 0)
-    return kInvalidSlotID;
+    // Start at a random shard of the bucket, and fall back to the others in
+    // order.
+    const size_t FirstShard = BucketBegin / SlotsPerShard;
+    const size_t BucketShards =
+        (BucketEnd - 1) / SlotsPerShard + 1 - FirstShard;
+    const size_t StartShard = getRandomUnsigned32() % BucketShards;
+    for (size_t i = 0; i < BucketShards; ++i) {
+      size_t SlotIndex = reserveSlotInShard(
+          Shards[FirstShard + (StartShard + i) % BucketShards], BucketBegin,
+          BucketEnd);
+      if (SlotIndex != kInvalidSlotID)
+        return SlotIndex;
+    }
+  }
+  return kInvalidSlotID;
+}
 
-  size_t ReservedIndex = getRandomUnsigned32() % FreeSlotsLength;
-  size_t SlotIndex = FreeSlots[ReservedIndex];
-  FreeSlots[ReservedIndex] = FreeSlots[--FreeSlotsLength];
-  return SlotIndex;
+size_t GuardedPoolAllocator::reserveSlotInShard(SlotShard &Shard, size_t Begin,
+                                                size_t End) {
+  ScopedLock L(Shard.Mu);
+  while (true) {
+    // Start at a random free slot, and take the first one in range. Only a
+    // shard that straddles the end of a bucket holds slots out of range.
+    const size_t Length = Shard.FreeSlotsLength;
+    const size_t Start = Length ? getRandomUnsigned32() % Length : 0;
+    for (size_t i = 0; i < Length; ++i) {
+      size_t ReservedIndex = (Start + i) % Length;
+      size_t SlotIndex = Shard.FreeSlots[ReservedIndex];
+      if (SlotIndex < Begin || SlotIndex >= End)
+        continue;
+      Shard.FreeSlots[ReservedIndex] = Shard.FreeSlots[--Shard.FreeSlotsLength];
+      return SlotIndex;
+    }
+    if (Shard.PendingSlotsLength == 0)
+      return kInvalidSlotID;
+    releasePendingSlots(Shard);
+  }
 }
 
 void GuardedPoolAllocator::freeSlot(size_t SlotIndex) {
-  assert(FreeSlotsLength < State.MaxSimultaneousAllocations);
-  FreeSlots[FreeSlotsLength++] = SlotIndex;
+  SlotShard &Shard = getShard(SlotIndex);
+  ScopedLock L(Shard.Mu);
+  assert(Shard.PendingSlotsLength < kReleaseBatchSize);
+  Shard.PendingSlots[Shard.PendingSlotsLength++] = SlotIndex;
+  if (Shard.PendingSlotsLength == kReleaseBatchSize)
+    releasePendingSlots(Shard);
+}
+
+void GuardedPoolAllocator::releasePendingSlots(SlotShard &Shard) {
+  size_t *Pending = Shard.PendingSlots;
+  const size_t NumPending = Shard.PendingSlotsLength;
+  // Sort the slots, so that runs of adjacent ones are released at once. The
+  // guard pages between them are inaccessible too.
+  for (size_t i = 1; i < NumPending; ++i) {
+    for (size_t j = i; j > 0 && Pending[j - 1] > Pending[j]; --j) {
+      size_t Tmp = Pending[j];
+      Pending[j] = Pending[j - 1];
+      Pending[j - 1] = Tmp;
+    }
+  }
+  size_t RunEnd;
+  for (size_t RunBegin = 0; RunBegin < NumPending; RunBegin = RunEnd) {
+    RunEnd = RunBegin + 1;
+    while (RunEnd < NumPending && Pending[RunEnd] == Pending[RunEnd - 1] + 1)
+      ++RunEnd;
+    uintptr_t Start = State.slotToAddr(Pending[RunBegin]);
+    uintptr_t End = State.slotToAddr(Pending[RunEnd - 1]) +
+                    State.slotSize(Pending[RunEnd - 1]);
+    releaseInGuardedPool(reinterpret_cast<void *>(Start), End - Start);
+  }
+
+  for (size_t i = 0; i < NumPending; ++i) {
+    assert(Shard.FreeSlotsLength < SlotsPerShard);
+    Shard.FreeSlots[Shard.FreeSlotsLength++] = Pending[i];
+  }
+  Shard.PendingSlotsLength = 0;
+}
+
+void GuardedPoolAllocator::setSampleRate(uint32_t Rate) {
+  SampleRate = Rate;
+  // Multiply the sample rate by 2 to give a good, fast approximation for (1 /
+  // SampleRate) chance of sampling.
+  uint32_t RatePlusOne = Rate != 1 ? Rate * 2 + 1 : 2;
+  __atomic_store_n(&AdjustedSampleRatePlusOne, RatePlusOne, __ATOMIC_RELAXED);
+}
+
+uint32_t GuardedPoolAllocator::adaptSampleRate(uint32_t Rate,
+                                               uint32_t Samples,
+                                               uint64_t ElapsedNs,
+                                               uint32_t TargetSamplesPerSecond,
+                                               bool OverOccupied) {
+  // The number of samples is proportional to 1 / SampleRate, so scale the rate
+  // by how many samples we got over how many we wanted. The scale is in
+  // sixteenths.
+  uint64_t ElapsedMs = ElapsedNs / 1000000;
+  if (ElapsedMs == 0)
+    ElapsedMs = 1;
+  const uint64_t WantedSamplesTimes1000 =
+      static_cast<uint64_t>(TargetSamplesPerSecond) * ElapsedMs;
+  uint64_t Scale = static_cast<uint64_t>(Samples) * 1000 * 16 /
+                   (WantedSamplesTimes1000 ? WantedSamplesTimes1000 : 1);
+  if (Scale < 16 / kMaxSampleRateStep)
+    Scale = 16 / kMaxSampleRateStep;
+  if (Scale > 16 * kMaxSampleRateStep)
+    Scale = 16 * kMaxSampleRateStep;
+  if (OverOccupied && Scale < 32)
+    Scale = 32;
+  const uint64_t NewRate = (static_cast<uint64_t>(Rate) * Scale + 8) / 16;
+  if (NewRate < 1)
+    return 1;
+  return NewRate > kMaxSampleRate ? kMaxSampleRate
+                                  : static_cast<uint32_t>(NewRate);
+}
+
+bool GuardedPoolAllocator::sizeClassAccepts(size_t Size) {
+  if (!SizeClassWeighting || ActiveSizeClasses == 0)
+    return true;
+  // A class that got k times its share of recent samples is only guarded with
+  // probability 1 / (k + 1). Classes below their share are always guarded.
+  const uint32_t Count = SizeClassSamples[getSizeClass(Size, kNumSizeClasses)];
+  const uint32_t Share = SizeClassSamplesTotal / ActiveSizeClasses + 1;
+  return getRandomUnsigned32() % (Count / Share + 1) == 0;
+}
+
+void GuardedPoolAllocator::recordSample(size_t Size) {
+  uint32_t &Count = SizeClassSamples[getSizeClass(Size, kNumSizeClasses)];
+  if (Count++ == 0)
+    ++ActiveSizeClasses;
+  ++SizeClassSamplesTotal;
+
+  ++SamplesInWindow;
+  const size_t OccupiedSlots =
+      __atomic_load_n(&NumAllocatedSlots, __ATOMIC_RELAXED);
+  const bool OverOccupied = OccupiedSlots > TargetOccupiedSlots;
+  const uint64_t Now = getPlatformMonotonicTimeNs();
+  const uint64_t ElapsedNs = Now - SampleWindowStartNs;
+  if (ElapsedNs < kSampleWindowNs && !OverOccupied &&
+      SamplesInWindow <= 2 * TargetSamplesPerSecond)
+    return;
+
+  setSampleRate(adaptSampleRate(SampleRate, SamplesInWindow, ElapsedNs,
+                                TargetSamplesPerSecond, OverOccupied));
+  SampleWindowStartNs = Now;
+  SamplesInWindow = 0;
+
+  ActiveSizeClasses = 0;
+  SizeClassSamplesTotal = 0;
+  for (uint32_t &C : SizeClassSamples) {
+    C /= 2;
+    if (C) {
+      ++ActiveSizeClasses;
+      SizeClassSamplesTotal += C;
+    }
+  }
 }
 
 uint32_t GuardedPoolAllocator::getRandomUnsigned32() {
@@ -80,9 +80,14 @@ public:
     // class must be valid when zero-initialised, and we wish to sample as
     // infrequently as possible when this is the case, hence we underflow to
     // UINT32_MAX.
+    // With adaptive sampling, the rate may change under our feet, but it is
+    // only ever read here, once per sampled allocation.
     if (GWP_ASAN_UNLIKELY(getThreadLocals()->NextSampleCounter == 0))
       getThreadLocals()->NextSampleCounter =
-          ((getRandomUnsigned32() % (AdjustedSampleRatePlusOne - 1)) + 1) &
+          ((getRandomUnsigned32() %
+            (__atomic_load_n(&AdjustedSampleRatePlusOne, __ATOMIC_RELAXED) -
+             1)) +
+           1) &
           ThreadLocalPackedVariables::NextSampleCounterMask;
 
     return GWP_ASAN_UNLIKELY(--getThreadLocals()->NextSampleCounter == 0);
@@ -127,6 +132,18 @@ protected:
   static uintptr_t alignUp(uintptr_t Ptr, size_t Alignment);
   static uintptr_t alignDown(uintptr_t Ptr, size_t Alignment);
 
+  // Returns the sample rate for the next adaptive sampling window, given that
+  // sample rate `Rate` produced `Samples` guarded allocations in the last
+  // window of `ElapsedNs` nanoseconds. If `OverOccupied`, the pool is fuller
+  // than the target occupancy, and the rate is at least doubled.
+  static uint32_t adaptSampleRate(uint32_t Rate, uint32_t Samples,
+                                  uint64_t ElapsedNs,
+                                  uint32_t TargetSamplesPerSecond,
+                                  bool OverOccupied);
+
+  // Returns the current sample rate.
+  uint32_t getSampleRate() const { return SampleRate; }
+
 private:
   // Name of actively-occupied slot mappings.
   static constexpr const char *kGwpAsanAliveSlotName = "GWP-ASan Alive Slot";
@@ -138,6 +155,26 @@ private:
 
   static constexpr size_t kInvalidSlotID = SIZE_MAX;
 
+  // Largest supported sample rate.
+  static constexpr uint32_t kMaxSampleRate = (1U << 30) - 1;
+  // Length of an adaptive sampling window. The sample rate is recomputed at
+  // most once per window, unless the pool fills up or a burst of allocations
+  // is sampled.
+  static constexpr uint64_t kSampleWindowNs = 1000000000;
+  // The rate changes by at most this factor per window, so that a single
+  // burst or lull does not swing it too far.
+  static constexpr uint32_t kMaxSampleRateStep = 8;
+  // Number of size classes for size class weighting. Sizes are bucketed by
+  // powers of two from 16 bytes, and the last class takes all larger sizes.
+  static constexpr size_t kNumSizeClasses = 16;
+  // The free slot pool is split into up to kMaxSlotShards shards of at least
+  // kMinSlotsPerShard slots each.
+  static constexpr size_t kMaxSlotShards = 32;
+  static constexpr size_t kMinSlotsPerShard = 64;
+  // Freed slots are made inaccessible at once, but their memory is released
+  // to the system in batches of up to this many slots per shard.
+  static constexpr size_t kReleaseBatchSize = 16;
+
   // These functions anonymously map memory or change the permissions of mapped
   // memory into this process in a platform-specific way. Pointer and size
   // arguments are expected to be page-aligned. These functions will never
@@ -163,25 +200,70 @@ private:
   // reserved pool range.
   void allocateInGuardedPool(void *Ptr, size_t Size) const;
   // deallocateInGuardedPool() Ptr and Size must be an exact pair previously
-  // passed to allocateInGuardedPool().
+  // passed to allocateInGuardedPool(). The memory becomes inaccessible, but
+  // may only be returned to the system by releaseInGuardedPool().
   void deallocateInGuardedPool(void *Ptr, size_t Size) const;
+  // releaseInGuardedPool() Ptr and Size must be a subrange of the reserved
+  // pool range that is entirely inaccessible. Returns the memory to the system,
+  // so that it reads as zero when allocated again.
+  void releaseInGuardedPool(void *Ptr, size_t Size) const;
   void unreserveGuardedPool();
 
   // Get the page size from the platform-specific implementation. Only needs to
   // be called once, and the result should be cached in PageSize in this class.
   static size_t getPlatformPageSize();
 
+  // Returns a monotonic timestamp in nanoseconds, platform-specific.
+  static uint64_t getPlatformMonotonicTimeNs();
+
   // Returns a pointer to the metadata for the owned pointer. If the pointer is
   // not owned by this pool, the result is undefined.
   AllocationMetadata *addrToMetadata(uintptr_t Ptr) const;
 
-  // Reserve a slot for a new guarded allocation. Returns kInvalidSlotID if no
-  // slot is available to be reserved.
-  size_t reserveSlot();
+  // A shard of the free slot pool. Each slot belongs to one shard, and goes
+  // back to it when freed, so that threads mostly take different locks.
+  // Aligned to avoid false sharing between the shards.
+  struct alignas(64) SlotShard {
+    // Protects the shard, and the metadata of its slots.
+    Mutex Mu;
+    // Free slots that can be handed out, in a subrange of FreeSlots.
+    size_t *FreeSlots = nullptr;
+    size_t FreeSlotsLength = 0;
+    // Freed slots whose memory has not been released to the system yet.
+    size_t PendingSlots[kReleaseBatchSize] = {};
+    size_t PendingSlotsLength = 0;
+  };
+
+  // Returns the shard that the slot belongs to.
+  SlotShard &getShard(size_t SlotIndex) {
+    return Shards[SlotIndex / SlotsPerShard];
+  }
+
+  // Reserve a slot for a new guarded allocation, from bucket `MinBucket` or a
+  // larger one. Returns kInvalidSlotID if no slot is available to be reserved.
+  size_t reserveSlot(size_t MinBucket);
+  // Reserve a free slot in [Begin, End) from `Shard`, or return kInvalidSlotID.
+  size_t reserveSlotInShard(SlotShard &Shard, size_t Begin, size_t End);
 
-  // Unreserve the guarded slot.
+  // Unreserve the guarded slot. Its memory must already be inaccessible.
   void freeSlot(size_t SlotIndex);
 
+  // Release the memory of the pending slots of `Shard` and make them available
+  // for reuse. Must be called with the shard's mutex held.
+  void releasePendingSlots(SlotShard &Shard);
+
+  // Sets the sample rate used when sample counters are regenerated.
+  void setSampleRate(uint32_t Rate);
+
+  // Returns whether size class weighting lets a sampled allocation of `Size`
+  // bytes be guarded. Must be called with PoolMutex held.
+  bool sizeClassAccepts(size_t Size);
+
+  // Records a guarded allocation of `Size` bytes for adaptive sampling, and
+  // adapts the sample rate at the end of each window. Must be called with
+  // PoolMutex held.
+  void recordSample(size_t Size);
+
   // Raise a SEGV and set the corresponding fields in the Allocator's State in
   // order to tell the crash handler what happened. Used when errors are
   // detected internally (Double Free, Invalid Free).
@@ -194,24 +276,33 @@ private:
 
   gwp_asan::AllocatorState State;
 
-  // A mutex to protect the guarded slot and metadata pool for this class.
+  // A mutex to protect the adaptive sampling state, and to serialise error
+  // reports. Slots and their metadata are protected by the mutexes of the
+  // shards. Lock order: shard mutexes, PoolMutex, BacktraceMutex.
   Mutex PoolMutex;
   // Some unwinders can grab the libdl lock. In order to provide atfork
   // protection, we need to ensure that we allow an unwinding thread to release
   // the libdl lock before forking.
   Mutex BacktraceMutex;
-  // Record the number allocations that we've sampled. We store this amount so
-  // that we don't randomly choose to recycle a slot that previously had an
-  // allocation before all the slots have been utilised.
-  size_t NumSampledAllocations = 0;
+  // Record the number allocations that we've sampled in each bucket. We store
+  // this amount so that we don't randomly choose to recycle a slot that
+  // previously had an allocation before all the slots of the bucket have been
+  // utilised. Updated atomically, and may overshoot the size of the bucket.
+  size_t NumSampledAllocations[AllocatorState::kMaxSlotBuckets] = {};
+  // Number of slots in use. Only maintained with adaptive sampling, which
+  // needs the pool occupancy. Updated atomically.
+  size_t NumAllocatedSlots = 0;
   // Pointer to the allocation metadata (allocation/deallocation stack traces),
   // if any.
   AllocationMetadata *Metadata = nullptr;
 
-  // Pointer to an array of free slot indexes.
+  // Pointer to an array of free slot indexes, split between the shards.
   size_t *FreeSlots = nullptr;
-  // The current length of the list of free slots.
-  size_t FreeSlotsLength = 0;
+  // Shards of the free slot pool. Shard N owns the slots in
+  // [N * SlotsPerShard, (N + 1) * SlotsPerShard).
+  SlotShard Shards[kMaxSlotShards];
+  size_t NumShards = 0;
+  size_t SlotsPerShard = 1;
 
   // See options.{h, inc} for more information.
   bool PerfectlyRightAlign = false;
@@ -227,6 +318,22 @@ private:
   // GWP-ASan is disabled, we wish to never spend wasted cycles recalculating
   // the sample rate.
   uint32_t AdjustedSampleRatePlusOne = 0;
+  // The sample rate that AdjustedSampleRatePlusOne was computed from.
+  uint32_t SampleRate = 0;
+
+  // Adaptive sampling state, see options.inc. Sampling is adaptive if
+  // TargetSamplesPerSecond is nonzero. Protected by PoolMutex.
+  uint32_t TargetSamplesPerSecond = 0;
+  size_t TargetOccupiedSlots = 0;
+  bool SizeClassWeighting = false;
+  // Start of the current window, and guarded allocations made during it.
+  uint64_t SampleWindowStartNs = 0;
+  uint32_t SamplesInWindow = 0;
+  // Recent guarded allocations per size class. Halved at the end of each
+  // window, so that old allocations count less.
+  uint32_t SizeClassSamples[kNumSizeClasses] = {};
+  uint32_t SizeClassSamplesTotal = 0;
+  uint32_t ActiveSizeClasses = 0;
 
   // Additional platform specific data structure for the guarded pool mapping.
   PlatformSpecificMapData GuardedPagePoolPlatformData = {};
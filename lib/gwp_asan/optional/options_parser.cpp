@@ -246,6 +246,25 @@ void initOptions(const char *OptionsStr, Printf_t PrintfForWarnings) {
         "GWP-ASan ERROR: SampleRate must be > 0 when GWP-ASan is enabled.\n");
     o->Enabled = false;
   }
+  if (o->MaximumAllocationSize < 0) {
+    InvokeIfNonNull(PrintfForWarnings,
+                    "GWP-ASan ERROR: MaximumAllocationSize must be >= 0 when "
+                    "GWP-ASan is enabled.\n");
+    o->Enabled = false;
+  }
+  if (o->TargetSampledAllocationsPerSecond < 0) {
+    InvokeIfNonNull(PrintfForWarnings,
+                    "GWP-ASan ERROR: TargetSampledAllocationsPerSecond must be "
+                    ">= 0 when GWP-ASan is enabled.\n");
+    o->Enabled = false;
+  }
+  if (o->TargetPoolOccupancyPercent <= 0 ||
+      o->TargetPoolOccupancyPercent > 100) {
+    InvokeIfNonNull(PrintfForWarnings,
+                    "GWP-ASan ERROR: TargetPoolOccupancyPercent must be in "
+                    "(0, 100] when GWP-ASan is enabled.\n");
+    o->Enabled = false;
+  }
 }
 
 void initOptions(Printf_t PrintfForWarnings) {
@@ -96,9 +96,19 @@ void GuardedPoolAllocator::deallocateInGuardedPool(void *Ptr,
   Check(Status == ZX_OK, "Vmar unmapping failed");
 }
 
+void GuardedPoolAllocator::releaseInGuardedPool(void *Ptr, size_t Size) const {
+  // deallocateInGuardedPool() already unmapped the memory.
+  (void)Ptr;
+  (void)Size;
+}
+
 size_t GuardedPoolAllocator::getPlatformPageSize() {
   return _zx_system_get_page_size();
 }
 
+uint64_t GuardedPoolAllocator::getPlatformMonotonicTimeNs() {
+  return _zx_clock_get_monotonic();
+}
+
 void GuardedPoolAllocator::installAtFork() {}
 } // namespace gwp_asan
@@ -84,19 +84,41 @@ void GuardedPoolAllocator::deallocateInGuardedPool(void *Ptr,
                                                    size_t Size) const {
   assert((reinterpret_cast<uintptr_t>(Ptr) % State.PageSize) == 0);
   assert((Size % State.PageSize) == 0);
-  // mmap() a PROT_NONE page over the address to release it to the system, if
-  // we used mprotect() here the system would count pages in the quarantine
-  // against the RSS.
+  // The pages still count against the RSS until releaseInGuardedPool() is
+  // called on a batch of freed slots.
+  Check(mprotect(Ptr, Size, PROT_NONE) == 0,
+        "Failed to deallocate in guarded pool allocator memory");
+  MaybeSetMappingName(Ptr, Size, kGwpAsanGuardPageName);
+}
+
+void GuardedPoolAllocator::releaseInGuardedPool(void *Ptr, size_t Size) const {
+  assert((reinterpret_cast<uintptr_t>(Ptr) % State.PageSize) == 0);
+  assert((Size % State.PageSize) == 0);
+#if defined(__linux__)
+  // The pages are already inaccessible. Dropping them is cheaper than mapping
+  // over them, and they read as zero when they are made accessible again.
+  Check(madvise(Ptr, Size, MADV_DONTNEED) == 0,
+        "Failed to release guarded pool allocator memory");
+#else
+  // mmap() a PROT_NONE page over the address to release it to the system, and
+  // to have it zeroed when it is allocated again.
   Check(mmap(Ptr, Size, PROT_NONE, MAP_FIXED | MAP_ANONYMOUS | MAP_PRIVATE, -1,
              0) != MAP_FAILED,
-        "Failed to deallocate in guarded pool allocator memory");
+        "Failed to release guarded pool allocator memory");
   MaybeSetMappingName(Ptr, Size, kGwpAsanGuardPageName);
+#endif
 }
 
 size_t GuardedPoolAllocator::getPlatformPageSize() {
   return sysconf(_SC_PAGESIZE);
 }
 
+uint64_t GuardedPoolAllocator::getPlatformMonotonicTimeNs() {
+  timespec TS;
+  clock_gettime(CLOCK_MONOTONIC, &TS);
+  return static_cast<uint64_t>(TS.tv_sec) * 1000000000 + TS.tv_nsec;
+}
+
 void GuardedPoolAllocator::installAtFork() {
   auto Disable = []() {
     if (auto *S = getSingleton())
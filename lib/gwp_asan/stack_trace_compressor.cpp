@@ -64,12 +64,15 @@ uintptr_t zigzagDecode(uintptr_t Value) {
     return Decoded;
   return ~Decoded;
 }
-} // anonymous namespace
 
-size_t pack(const uintptr_t *Unpacked, size_t UnpackedSize, uint8_t *Packed,
-            size_t PackedMaxSize) {
+// Packs the stack trace like pack(), and sets `PackedFrames` to the number of
+// frames that fit in the output buffer.
+size_t packFrames(const uintptr_t *Unpacked, size_t UnpackedSize,
+                  uint8_t *Packed, size_t PackedMaxSize,
+                  size_t *PackedFrames) {
   size_t Index = 0;
-  for (size_t CurrentDepth = 0; CurrentDepth < UnpackedSize; CurrentDepth++) {
+  size_t CurrentDepth;
+  for (CurrentDepth = 0; CurrentDepth < UnpackedSize; CurrentDepth++) {
     uintptr_t Diff = Unpacked[CurrentDepth];
     if (CurrentDepth > 0)
       Diff -= Unpacked[CurrentDepth - 1];
@@ -81,13 +84,23 @@ size_t pack(const uintptr_t *Unpacked, size_t UnpackedSize, uint8_t *Packed,
     Index += EncodedLength;
   }
 
+  *PackedFrames = CurrentDepth;
   return Index;
 }
+} // anonymous namespace
+
+size_t pack(const uintptr_t *Unpacked, size_t UnpackedSize, uint8_t *Packed,
+            size_t PackedMaxSize) {
+  size_t PackedFrames;
+  return packFrames(Unpacked, UnpackedSize, Packed, PackedMaxSize,
+                    &PackedFrames);
+}
 
 size_t unpack(const uint8_t *Packed, size_t PackedSize, uintptr_t *Unpacked,
               size_t UnpackedMaxSize) {
   size_t CurrentDepth;
   size_t Index = 0;
+  uintptr_t Frame = 0;
   for (CurrentDepth = 0; CurrentDepth < UnpackedMaxSize; CurrentDepth++) {
     uintptr_t EncodedDiff;
     size_t DecodedLength =
@@ -96,9 +109,8 @@ size_t unpack(const uint8_t *Packed, size_t PackedSize, uintptr_t *Unpacked,
       break;
     Index += DecodedLength;
 
-    Unpacked[CurrentDepth] = zigzagDecode(EncodedDiff);
-    if (CurrentDepth > 0)
-      Unpacked[CurrentDepth] += Unpacked[CurrentDepth - 1];
+    Frame += zigzagDecode(EncodedDiff);
+    Unpacked[CurrentDepth] = Frame;
   }
 
   if (Index != PackedSize && CurrentDepth != UnpackedMaxSize)
@@ -107,5 +119,56 @@ size_t unpack(const uint8_t *Packed, size_t PackedSize, uintptr_t *Unpacked,
   return CurrentDepth;
 }
 
+size_t packWithBase(const uintptr_t *Unpacked, size_t UnpackedSize,
+                    const uintptr_t *Base, size_t BaseSize, uint8_t *Packed,
+                    size_t PackedMaxSize) {
+  // The packed trace starts with the number of shared frames, followed by the
+  // other frames, packed like pack() does.
+  size_t SharedFrames = 0;
+  while (SharedFrames < UnpackedSize && SharedFrames < BaseSize &&
+         Unpacked[UnpackedSize - SharedFrames - 1] ==
+             Base[BaseSize - SharedFrames - 1])
+    ++SharedFrames;
+
+  size_t Index = varIntEncode(SharedFrames, Packed, PackedMaxSize);
+  if (!Index)
+    return 0;
+  size_t PackedFrames;
+  size_t EncodedLength =
+      packFrames(Unpacked, UnpackedSize - SharedFrames, Packed + Index,
+                 PackedMaxSize - Index, &PackedFrames);
+  if (PackedFrames == UnpackedSize - SharedFrames)
+    return Index + EncodedLength;
+
+  // Dropping frames in the middle of the trace would make it misleading.
+  if (!SharedFrames)
+    return Index + EncodedLength;
+  Index = varIntEncode(0, Packed, PackedMaxSize);
+  return Index + pack(Unpacked, UnpackedSize, Packed + Index,
+                      PackedMaxSize - Index);
+}
+
+size_t unpackWithBase(const uint8_t *Packed, size_t PackedSize,
+                      const uintptr_t *Base, size_t BaseSize,
+                      uintptr_t *Unpacked, size_t UnpackedMaxSize) {
+  uintptr_t SharedFrames;
+  size_t Index = varIntDecode(Packed, PackedSize, &SharedFrames);
+  if (!Index || SharedFrames > BaseSize)
+    return 0;
+
+  size_t CurrentDepth = 0;
+  if (Index != PackedSize) {
+    CurrentDepth =
+        unpack(Packed + Index, PackedSize - Index, Unpacked, UnpackedMaxSize);
+    if (!CurrentDepth)
+      return 0;
+  }
+
+  const uintptr_t *Shared = Base + BaseSize - SharedFrames;
+  for (size_t i = 0; i < SharedFrames && CurrentDepth < UnpackedMaxSize; ++i)
+    Unpacked[CurrentDepth++] = Shared[i];
+  return CurrentDepth;
+}
+
 } // namespace compression
 } // namespace gwp_asan
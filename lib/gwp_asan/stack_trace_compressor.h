@@ -15,7 +15,9 @@
 // These functions implement stack frame compression and decompression. We store
 // the zig-zag encoded pointer difference between frame[i] and frame[i - 1] as
 // a variable-length integer. This can reduce the memory overhead of stack
-// traces by 50%.
+// traces by 50%. A trace can also be stored relative to a related base trace
+// (e.g. a deallocation trace relative to the allocation trace), in which case
+// the outermost frames that the two share are only stored as a count.
 
 namespace gwp_asan {
 namespace compression {
@@ -32,6 +34,22 @@ size_t pack(const uintptr_t *Unpacked, size_t UnpackedSize, uint8_t *Packed,
 size_t unpack(const uint8_t *Packed, size_t PackedSize, uintptr_t *Unpacked,
               size_t UnpackedMaxSize);
 
+// Like pack(), but the outermost frames that the stack trace in `Unpacked`
+// shares with the base stack trace in `Base` of length `BaseSize` are not
+// stored. If the other frames do not all fit, the trace is packed without
+// reference to `Base`, and truncated like pack() does. The result must be
+// unpacked with unpackWithBase() and the same base stack trace.
+size_t packWithBase(const uintptr_t *Unpacked, size_t UnpackedSize,
+                    const uintptr_t *Base, size_t BaseSize, uint8_t *Packed,
+                    size_t PackedMaxSize);
+
+// Unpacks a stack trace that was packed with packWithBase() and the base stack
+// trace in `Base` of length `BaseSize`. Returns the number of full entries
+// unpacked, or zero on error.
+size_t unpackWithBase(const uint8_t *Packed, size_t PackedSize,
+                      const uintptr_t *Base, size_t BaseSize,
+                      uintptr_t *Unpacked, size_t UnpackedMaxSize);
+
 } // namespace compression
 } // namespace gwp_asan
 
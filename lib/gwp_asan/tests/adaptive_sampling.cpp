@@ -0,0 +1,197 @@
+//===-- adaptive_sampling.cpp -----------------------------------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "gwp_asan/guarded_pool_allocator.h"
+#include "gwp_asan/tests/harness.h"
+
+#include <chrono>
+#include <stdio.h>
+
+class AdaptiveSamplingGPA : public gwp_asan::GuardedPoolAllocator {
+public:
+  static uint32_t adaptSampleRate(uint32_t Rate, uint32_t Samples,
+                                  uint64_t ElapsedNs,
+                                  uint32_t TargetSamplesPerSecond,
+                                  bool OverOccupied) {
+    return GuardedPoolAllocator::adaptSampleRate(
+        Rate, Samples, ElapsedNs, TargetSamplesPerSecond, OverOccupied);
+  }
+  uint32_t getSampleRate() const {
+    return GuardedPoolAllocator::getSampleRate();
+  }
+};
+
+class AdaptiveSamplingTest : public Test {
+public:
+  void InitAdaptive(int TargetSampledAllocationsPerSecond,
+                    int TargetPoolOccupancyPercent, bool SizeClassWeighting) {
+    gwp_asan::options::Options Opts;
+    Opts.setDefaults();
+
+    Opts.MaxSimultaneousAllocations = 16;
+    Opts.TargetSampledAllocationsPerSecond = TargetSampledAllocationsPerSecond;
+    Opts.TargetPoolOccupancyPercent = TargetPoolOccupancyPercent;
+    Opts.SizeClassWeighting = SizeClassWeighting;
+
+    Opts.InstallForkHandlers = gwp_asan::test::OnlyOnce();
+    GPA.init(Opts);
+  }
+
+  void TearDown() override { GPA.uninitTestOnly(); }
+
+protected:
+  AdaptiveSamplingGPA GPA;
+};
+
+static constexpr uint64_t kSecond = 1000000000;
+
+TEST(AdaptSampleRateTest, TracksTarget) {
+  EXPECT_EQ(1000u, AdaptiveSamplingGPA::adaptSampleRate(
+                       /* Rate */ 1000, /* Samples */ 100, kSecond,
+                       /* TargetSamplesPerSecond */ 100, false));
+  EXPECT_EQ(2000u, AdaptiveSamplingGPA::adaptSampleRate(1000, 200, kSecond,
+                                                        100, false));
+  EXPECT_EQ(500u, AdaptiveSamplingGPA::adaptSampleRate(1000, 50, kSecond, 100,
+                                                       false));
+  EXPECT_EQ(1000u, AdaptiveSamplingGPA::adaptSampleRate(1000, 50, kSecond / 2,
+                                                        100, false));
+}
+
+TEST(AdaptSampleRateTest, LimitsStep) {
+  EXPECT_EQ(8000u, AdaptiveSamplingGPA::adaptSampleRate(1000, 100000, kSecond,
+                                                        100, false));
+  EXPECT_EQ(125u, AdaptiveSamplingGPA::adaptSampleRate(1000, 1, 100 * kSecond,
+                                                       100, false));
+  EXPECT_EQ(8000u,
+            AdaptiveSamplingGPA::adaptSampleRate(1000, 1, 0, 100, false));
+}
+
+TEST(AdaptSampleRateTest, BacksOffWhenOverOccupied) {
+  EXPECT_EQ(2000u, AdaptiveSamplingGPA::adaptSampleRate(1000, 50, kSecond, 100,
+                                                        true));
+  EXPECT_EQ(4000u, AdaptiveSamplingGPA::adaptSampleRate(1000, 400, kSecond,
+                                                        100, true));
+}
+
+TEST(AdaptSampleRateTest, Clamps) {
+  EXPECT_EQ(1u, AdaptiveSamplingGPA::adaptSampleRate(1, 0, kSecond, 100,
+                                                     false));
+  EXPECT_EQ((1u << 30) - 1, AdaptiveSamplingGPA::adaptSampleRate(
+                                (1u << 30) - 1, 1000, kSecond, 1, false));
+}
+
+TEST_F(AdaptiveSamplingTest, BacksOffWhenPoolFills) {
+  InitAdaptive(/* TargetSampledAllocationsPerSecond */ 1000000,
+               /* TargetPoolOccupancyPercent */ 50,
+               /* SizeClassWeighting */ false);
+  void *Ptrs[10];
+  for (unsigned i = 0; i < 8; ++i) {
+    Ptrs[i] = GPA.allocate(1);
+    ASSERT_NE(nullptr, Ptrs[i]);
+  }
+  uint32_t Rate = GPA.getSampleRate();
+  for (unsigned i = 8; i < 10; ++i) {
+    Ptrs[i] = GPA.allocate(1);
+    ASSERT_NE(nullptr, Ptrs[i]);
+    EXPECT_EQ(2 * Rate, GPA.getSampleRate());
+    Rate = GPA.getSampleRate();
+  }
+  for (void *Ptr : Ptrs)
+    GPA.deallocate(Ptr);
+}
+
+TEST_F(AdaptiveSamplingTest, BacksOffOnBurst) {
+  InitAdaptive(/* TargetSampledAllocationsPerSecond */ 1,
+               /* TargetPoolOccupancyPercent */ 100,
+               /* SizeClassWeighting */ false);
+  const uint32_t Rate = GPA.getSampleRate();
+  for (unsigned i = 0; i < 3; ++i) {
+    EXPECT_EQ(Rate, GPA.getSampleRate());
+    void *Ptr = GPA.allocate(1);
+    ASSERT_NE(nullptr, Ptr);
+    GPA.deallocate(Ptr);
+  }
+  EXPECT_EQ(8 * Rate, GPA.getSampleRate());
+}
+
+TEST_F(AdaptiveSamplingTest, SizeClassWeighting) {
+  InitAdaptive(/* TargetSampledAllocationsPerSecond */ 1000000,
+               /* TargetPoolOccupancyPercent */ 100,
+               /* SizeClassWeighting */ true);
+  // A single size class is never skipped.
+  for (unsigned i = 0; i < 200; ++i) {
+    void *Ptr = GPA.allocate(8);
+    ASSERT_NE(nullptr, Ptr);
+    GPA.deallocate(Ptr);
+  }
+  // A rare size class is always guarded.
+  void *Ptr = GPA.allocate(4096);
+  ASSERT_NE(nullptr, Ptr);
+  GPA.deallocate(Ptr);
+
+  // Now the common size class is over its share.
+  unsigned Skipped = 0;
+  for (unsigned i = 0; i < 200; ++i) {
+    Ptr = GPA.allocate(8);
+    if (!Ptr) {
+      ++Skipped;
+      continue;
+    }
+    GPA.deallocate(Ptr);
+  }
+  EXPECT_GT(Skipped, 0u);
+  EXPECT_LT(Skipped, 200u);
+
+  Ptr = GPA.allocate(4096);
+  ASSERT_NE(nullptr, Ptr);
+  GPA.deallocate(Ptr);
+}
+
+static unsigned countSamples(gwp_asan::GuardedPoolAllocator *GPA,
+                             unsigned Calls) {
+  unsigned Sampled = 0;
+  for (unsigned i = 0; i < Calls; ++i)
+    Sampled += GPA->shouldSample();
+  return Sampled;
+}
+
+TEST_F(DefaultGuardedPoolAllocator, ShouldSampleSamples) {
+  EXPECT_GT(countSamples(&GPA, 1 << 16), 0u);
+}
+
+TEST_F(AdaptiveSamplingTest, ShouldSampleSamples) {
+  InitAdaptive(/* TargetSampledAllocationsPerSecond */ 10,
+               /* TargetPoolOccupancyPercent */ 75,
+               /* SizeClassWeighting */ true);
+  EXPECT_GT(countSamples(&GPA, 1 << 16), 0u);
+}
+
+// Prints the cost of shouldSample(), which is on the malloc() fast path of the
+// supporting allocator, with a fixed and an adaptive sample rate. Run manually
+// with --gtest_also_run_disabled_tests.
+static void measureShouldSample(gwp_asan::GuardedPoolAllocator *GPA,
+                                const char *Name) {
+  constexpr unsigned kCalls = 1 << 24;
+  auto Start = std::chrono::steady_clock::now();
+  countSamples(GPA, kCalls);
+  auto End = std::chrono::steady_clock::now();
+  printf("shouldSample() with %s sample rate: %.2f ns/call\n", Name,
+         std::chrono::duration<double, std::nano>(End - Start).count() /
+             kCalls);
+}
+
+TEST_F(DefaultGuardedPoolAllocator, DISABLED_ShouldSampleCost) {
+  measureShouldSample(&GPA, "a fixed");
+}
+
+TEST_F(AdaptiveSamplingTest, DISABLED_ShouldSampleCost) {
+  InitAdaptive(/* TargetSampledAllocationsPerSecond */ 10,
+               /* TargetPoolOccupancyPercent */ 75,
+               /* SizeClassWeighting */ true);
+  measureShouldSample(&GPA, "an adaptive");
+}
@@ -119,7 +119,8 @@ TEST(Backtrace, ExceedsRetrievableDeallocLength) {
         memset(TraceBuffer, kNumFramesToStore,
                kNumFramesToStore * sizeof(*TraceBuffer));
         return kNumFramesToStore;
-      });
+      },
+      &Meta.AllocationTrace);
   uintptr_t TraceOutput;
   // Ask for one element, get told that there's `kNumFramesToStore` available.
   EXPECT_EQ(kNumFramesToStore,
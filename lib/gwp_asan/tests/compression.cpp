@@ -7,8 +7,13 @@
 //===----------------------------------------------------------------------===//
 
 #include "gwp_asan/stack_trace_compressor.h"
+#include "gwp_asan/common.h"
 #include "gwp_asan/tests/harness.h"
 
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+
 namespace gwp_asan {
 namespace compression {
 
@@ -263,5 +268,229 @@ TEST(GwpAsanCompressionTest, CompressPartiallySucceedsWithTooSmallBuffer) {
   EXPECT_EQ(pack(Uncompressed, 3u, Compressed, 6u), 5u);
   EXPECT_EQ(pack(Uncompressed, 3u, Compressed, 3 * kBytesForLargestVarInt), 5u);
 }
+
+TEST(GwpAsanCompressionTest, PackWithBaseSharesOutermostFrames) {
+  uintptr_t Base[] = {0x1000, 0x7fff12345678, 0x7fff23456789, 0x7fff3456789a};
+  uintptr_t Uncompressed[] = {0x20, 0x30, 0x7fff23456789, 0x7fff3456789a};
+  uint8_t Compressed[4 * kBytesForLargestVarInt];
+
+  // One byte for the number of shared frames, and one for each of the others.
+  size_t CompressedSize = packWithBase(Uncompressed, 4u, Base, 4u, Compressed,
+                                       sizeof(Compressed));
+  EXPECT_EQ(3u, CompressedSize);
+  EXPECT_EQ(2u, Compressed[0]);
+
+  uintptr_t Decompressed[4];
+  EXPECT_EQ(4u, unpackWithBase(Compressed, CompressedSize, Base, 4u,
+                               Decompressed, 4u));
+  EXPECT_EQ(0, memcmp(Uncompressed, Decompressed, sizeof(Uncompressed)));
+
+  // An identical trace is a single byte.
+  CompressedSize =
+      packWithBase(Base, 4u, Base, 4u, Compressed, sizeof(Compressed));
+  EXPECT_EQ(1u, CompressedSize);
+  EXPECT_EQ(4u, unpackWithBase(Compressed, CompressedSize, Base, 4u,
+                               Decompressed, 4u));
+  EXPECT_EQ(0, memcmp(Base, Decompressed, sizeof(Base)));
+
+  // Only as many frames as fit are unpacked.
+  EXPECT_EQ(3u, unpackWithBase(Compressed, CompressedSize, Base, 4u,
+                               Decompressed, 3u));
+  EXPECT_EQ(0, memcmp(Base, Decompressed, 3 * sizeof(*Base)));
+}
+
+TEST(GwpAsanCompressionTest, PackWithBaseWithoutSharedFrames) {
+  uintptr_t Base[] = {0x1000, 0x2000};
+  uintptr_t Uncompressed[] = {0x3000, 0x4000};
+  uint8_t Compressed[2 * kBytesForLargestVarInt + 1];
+  size_t CompressedSize = packWithBase(Uncompressed, 2u, Base, 2u, Compressed,
+                                       sizeof(Compressed));
+  EXPECT_EQ(1 + pack(Uncompressed, 2u, Compressed, sizeof(Compressed)),
+            CompressedSize);
+
+  CompressedSize = packWithBase(Uncompressed, 2u, Base, 2u, Compressed,
+                                sizeof(Compressed));
+  uintptr_t Decompressed[2];
+  EXPECT_EQ(2u, unpackWithBase(Compressed, CompressedSize, Base, 2u,
+                               Decompressed, 2u));
+  EXPECT_EQ(0, memcmp(Uncompressed, Decompressed, sizeof(Uncompressed)));
+
+  // An empty base works too.
+  CompressedSize = packWithBase(Uncompressed, 2u, nullptr, 0u, Compressed,
+                                sizeof(Compressed));
+  EXPECT_EQ(2u, unpackWithBase(Compressed, CompressedSize, nullptr, 0u,
+                               Decompressed, 2u));
+  EXPECT_EQ(0, memcmp(Uncompressed, Decompressed, sizeof(Uncompressed)));
+}
+
+TEST(GwpAsanCompressionTest, PackWithBaseDoesNotDropMiddleFrames) {
+  uintptr_t Base[] = {0x1000, 0x7fff12345678};
+  uintptr_t Uncompressed[] = {0x1000, 0x7fff00000000, 0x7fff12345678};
+  uint8_t Compressed[4];
+  // The unshared frames take more than four bytes, so the trace is packed
+  // without the base, and truncated at its outermost end.
+  size_t CompressedSize = packWithBase(Uncompressed, 3u, Base, 2u, Compressed,
+                                       sizeof(Compressed));
+  EXPECT_EQ(0u, Compressed[0]);
+
+  uintptr_t Decompressed[3];
+  EXPECT_EQ(1u, unpackWithBase(Compressed, CompressedSize, Base, 2u,
+                               Decompressed, 3u));
+  EXPECT_EQ(0x1000u, Decompressed[0]);
+}
+
+TEST(GwpAsanCompressionTest, UnpackWithBaseFailsOnBadInput) {
+  uintptr_t Base[] = {0x1000, 0x2000};
+  uintptr_t Decompressed[4];
+  // More shared frames than the base has.
+  uint8_t Compressed[] = {0x03};
+  EXPECT_EQ(0u, unpackWithBase(Compressed, 1u, Base, 2u, Decompressed, 4u));
+  // Empty.
+  EXPECT_EQ(0u, unpackWithBase(Compressed, 0u, Base, 2u, Decompressed, 4u));
+  // Unterminated varint after the number of shared frames.
+  uint8_t Unterminated[] = {0x00, 0x80};
+  EXPECT_EQ(0u, unpackWithBase(Unterminated, 2u, Base, 2u, Decompressed, 4u));
+}
+
+// Real stack traces collected at various depths, which diverge a couple of
+// frames below a common caller, like an allocation and deallocation trace do.
+__attribute__((noinline)) static size_t collectTrace(uintptr_t *Trace,
+                                                     unsigned Depth) {
+  size_t Length;
+  if (Depth == 0)
+    Length = gwp_asan::backtrace::getBacktraceFunction()(
+        Trace, AllocationMetadata::kMaxTraceLengthToCollect);
+  else
+    Length = collectTrace(Trace, Depth - 1);
+  // Prevent tail calls, which would drop frames.
+  asm volatile("" : : : "memory");
+  return Length < AllocationMetadata::kMaxTraceLengthToCollect
+             ? Length
+             : AllocationMetadata::kMaxTraceLengthToCollect;
+}
+
+__attribute__((noinline)) static size_t
+collectAllocationTrace(uintptr_t *Trace) {
+  size_t Length = collectTrace(Trace, 2);
+  asm volatile("" : : : "memory");
+  return Length;
+}
+
+__attribute__((noinline)) static size_t
+collectDeallocationTrace(uintptr_t *Trace) {
+  size_t Length = collectTrace(Trace, 1);
+  asm volatile("" : : : "memory");
+  return Length;
+}
+
+__attribute__((noinline)) static void
+collectTraces(unsigned Depth, uintptr_t *AllocTrace, size_t *AllocLength,
+              uintptr_t *DeallocTrace, size_t *DeallocLength) {
+  if (Depth > 0) {
+    collectTraces(Depth - 1, AllocTrace, AllocLength, DeallocTrace,
+                  DeallocLength);
+  } else {
+    *AllocLength = collectAllocationTrace(AllocTrace);
+    *DeallocLength = collectDeallocationTrace(DeallocTrace);
+  }
+  asm volatile("" : : : "memory");
+}
+
+TEST(GwpAsanCompressionTest, RealStackTraces) {
+  constexpr size_t kMaxLength = AllocationMetadata::kMaxTraceLengthToCollect;
+  constexpr size_t kStorage = AllocationMetadata::kStackFrameStorageBytes;
+  constexpr unsigned kDepths[] = {4, 16, 32, 64};
+
+  for (unsigned Depth : kDepths) {
+    uintptr_t AllocTrace[kMaxLength], DeallocTrace[kMaxLength];
+    size_t AllocLength, DeallocLength;
+    collectTraces(Depth, AllocTrace, &AllocLength, DeallocTrace,
+                  &DeallocLength);
+    ASSERT_GT(AllocLength, 0u);
+    ASSERT_GT(DeallocLength, 0u);
+
+    uint8_t Packed[kStorage];
+    uintptr_t Unpacked[kMaxLength];
+    size_t AllocSize = pack(AllocTrace, AllocLength, Packed, kStorage);
+    ASSERT_EQ(AllocLength, unpack(Packed, AllocSize, Unpacked, kMaxLength));
+    EXPECT_EQ(0,
+              memcmp(AllocTrace, Unpacked, AllocLength * sizeof(*AllocTrace)));
+
+    size_t DeallocSize = pack(DeallocTrace, DeallocLength, Packed, kStorage);
+    size_t DeallocSizeWithBase =
+        packWithBase(DeallocTrace, DeallocLength, AllocTrace, AllocLength,
+                     Packed, kStorage);
+    EXPECT_LE(DeallocSizeWithBase, DeallocSize + 1);
+    ASSERT_EQ(DeallocLength,
+              unpackWithBase(Packed, DeallocSizeWithBase, AllocTrace,
+                             AllocLength, Unpacked, kMaxLength));
+    EXPECT_EQ(0, memcmp(DeallocTrace, Unpacked,
+                        DeallocLength * sizeof(*DeallocTrace)));
+  }
+}
+
+// Prints the size of the real stack traces above, packed with pack() and
+// relative to the allocation trace with packWithBase(), along with the cost of
+// packing and unpacking them. Run manually with
+// --gtest_also_run_disabled_tests.
+TEST(GwpAsanCompressionTest, DISABLED_RealStackTracesCost) {
+  constexpr size_t kMaxLength = AllocationMetadata::kMaxTraceLengthToCollect;
+  constexpr size_t kStorage = AllocationMetadata::kStackFrameStorageBytes;
+  constexpr unsigned kIterations = 1000;
+  constexpr unsigned kDepths[] = {4, 16, 32, 64};
+
+  for (unsigned Depth : kDepths) {
+    uintptr_t AllocTrace[kMaxLength], DeallocTrace[kMaxLength];
+    size_t AllocLength, DeallocLength;
+    collectTraces(Depth, AllocTrace, &AllocLength, DeallocTrace,
+                  &DeallocLength);
+
+    uint8_t Packed[kStorage];
+    uintptr_t Unpacked[kMaxLength];
+    size_t AllocSize = pack(AllocTrace, AllocLength, Packed, kStorage);
+    size_t DeallocSize = pack(DeallocTrace, DeallocLength, Packed, kStorage);
+    size_t DeallocSizeWithBase =
+        packWithBase(DeallocTrace, DeallocLength, AllocTrace, AllocLength,
+                     Packed, kStorage);
+
+    auto Start = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < kIterations; ++i) {
+      pack(AllocTrace, AllocLength, Packed, kStorage);
+      asm volatile("" : : "r"(Packed) : "memory");
+    }
+    auto PackEnd = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < kIterations; ++i) {
+      unpack(Packed, AllocSize, Unpacked, kMaxLength);
+      asm volatile("" : : "r"(Unpacked) : "memory");
+    }
+    auto UnpackEnd = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < kIterations; ++i) {
+      packWithBase(DeallocTrace, DeallocLength, AllocTrace, AllocLength,
+                   Packed, kStorage);
+      asm volatile("" : : "r"(Packed) : "memory");
+    }
+    auto PackWithBaseEnd = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < kIterations; ++i) {
+      unpackWithBase(Packed, DeallocSizeWithBase, AllocTrace, AllocLength,
+                     Unpacked, kMaxLength);
+      asm volatile("" : : "r"(Unpacked) : "memory");
+    }
+    auto UnpackWithBaseEnd = std::chrono::steady_clock::now();
+
+    auto NsPerCall = [](std::chrono::steady_clock::time_point Start,
+                        std::chrono::steady_clock::time_point End) {
+      return std::chrono::duration<double, std::nano>(End - Start).count() /
+             kIterations;
+    };
+    printf("%zu frames: allocation trace %zu bytes, deallocation trace %zu "
+           "bytes, or %zu bytes with base\n",
+           DeallocLength, AllocSize, DeallocSize, DeallocSizeWithBase);
+    printf("  pack %.0f ns, unpack %.0f ns, packWithBase %.0f ns, "
+           "unpackWithBase %.0f ns\n",
+           NsPerCall(Start, PackEnd), NsPerCall(PackEnd, UnpackEnd),
+           NsPerCall(UnpackEnd, PackWithBaseEnd),
+           NsPerCall(PackWithBaseEnd, UnpackWithBaseEnd));
+  }
+}
 } // namespace compression
 } // namespace gwp_asan
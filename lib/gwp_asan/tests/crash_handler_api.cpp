@@ -52,10 +52,11 @@ protected:
         AllocationMetadata::kStackFrameStorageBytes);
 
     if (Meta->IsDeallocated)
-      Meta->DeallocationTrace.TraceSize = gwp_asan::compression::pack(
-          BacktraceConstants, kNumBacktraceConstants,
-          Meta->DeallocationTrace.CompressedTrace,
-          AllocationMetadata::kStackFrameStorageBytes);
+      Meta->DeallocationTrace.TraceSize =
+          gwp_asan::compression::packWithBase(
+              BacktraceConstants, kNumBacktraceConstants, BacktraceConstants,
+              kNumBacktraceConstants, Meta->DeallocationTrace.CompressedTrace,
+              AllocationMetadata::kStackFrameStorageBytes);
   }
 
   void checkBacktrace(const AllocationMetadata *Meta, bool IsDeallocated) {
@@ -0,0 +1,165 @@
+//===-- multi_page.cpp ------------------------------------------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "gwp_asan/crash_handler.h"
+#include "gwp_asan/guarded_pool_allocator.h"
+#include "gwp_asan/tests/harness.h"
+
+#include <string.h>
+
+using AllocatorState = gwp_asan::AllocatorState;
+using Error = gwp_asan::Error;
+
+class MultiPageGuardedPoolAllocator : public Test {
+public:
+  void InitMaximumAllocationSize(int MaxSimultaneousAllocations,
+                                 int MaximumAllocationSize) {
+    gwp_asan::options::Options Opts;
+    Opts.setDefaults();
+
+    Opts.MaxSimultaneousAllocations = MaxSimultaneousAllocations;
+    Opts.MaximumAllocationSize = MaximumAllocationSize;
+
+    Opts.InstallForkHandlers = gwp_asan::test::OnlyOnce();
+    GPA.init(Opts);
+  }
+
+  void TearDown() override { GPA.uninitTestOnly(); }
+
+protected:
+  gwp_asan::GuardedPoolAllocator GPA;
+};
+
+TEST(AllocatorStateTest, SlotBuckets) {
+  // 0x2000: Guard page.
+  // 0x3000: Slot 0, 0x4000: Guard page.
+  // 0x5000: Slot 1, 0x6000: Guard page.
+  // 0x7000: Slot 2, 0x9000: Guard page.
+  // 0xa000: Slot 3, 0xc000: Guard page.
+  AllocatorState State;
+  State.GuardedPagePool = 0x2000;
+  State.GuardedPagePoolEnd = 0xd000;
+  State.MaxSimultaneousAllocations = 4;
+  State.PageSize = 0x1000;
+  State.NumSlotBuckets = 2;
+  State.SlotBucketStart[1] = 2;
+
+  EXPECT_EQ(0x2000u, State.maximumAllocationSize());
+  EXPECT_EQ(0x3000u, State.slotToAddr(0));
+  EXPECT_EQ(0x5000u, State.slotToAddr(1));
+  EXPECT_EQ(0x7000u, State.slotToAddr(2));
+  EXPECT_EQ(0xa000u, State.slotToAddr(3));
+  EXPECT_EQ(0xd000u, State.slotToAddr(4));
+  EXPECT_EQ(0x1000u, State.slotSize(1));
+  EXPECT_EQ(0x2000u, State.slotSize(2));
+
+  EXPECT_TRUE(State.isGuardPage(0x2000));
+  EXPECT_FALSE(State.isGuardPage(0x3000));
+  EXPECT_TRUE(State.isGuardPage(0x6fff));
+  EXPECT_FALSE(State.isGuardPage(0x8fff));
+  EXPECT_TRUE(State.isGuardPage(0x9000));
+  EXPECT_FALSE(State.isGuardPage(0xb000));
+  EXPECT_TRUE(State.isGuardPage(0xc000));
+
+  EXPECT_EQ(1u, State.getNearestSlot(0x6100));
+  EXPECT_EQ(2u, State.getNearestSlot(0x6900));
+  EXPECT_EQ(2u, State.getNearestSlot(0x8000));
+  EXPECT_EQ(2u, State.getNearestSlot(0x9100));
+  EXPECT_EQ(3u, State.getNearestSlot(0x9900));
+  EXPECT_EQ(3u, State.getNearestSlot(0xbfff));
+}
+
+TEST_F(MultiPageGuardedPoolAllocator, SizedAllocations) {
+  InitMaximumAllocationSize(16, 1 << 20);
+  const AllocatorState *State = GPA.getAllocatorState();
+  ASSERT_GT(State->maximumAllocationSize(), State->PageSize);
+
+  for (size_t AllocSize = 1; AllocSize <= State->maximumAllocationSize();
+       AllocSize <<= 1) {
+    void *Ptr = GPA.allocate(AllocSize);
+    ASSERT_NE(nullptr, Ptr);
+    EXPECT_TRUE(GPA.pointerIsMine(Ptr));
+    EXPECT_EQ(AllocSize, GPA.getSize(Ptr));
+    EXPECT_GE(State->slotSize(State->getNearestSlot(
+                  reinterpret_cast<uintptr_t>(Ptr))),
+              AllocSize);
+    memset(Ptr, 0x42, AllocSize);
+    GPA.deallocate(Ptr);
+  }
+  EXPECT_EQ(nullptr, GPA.allocate(State->maximumAllocationSize() + 1));
+}
+
+TEST_F(MultiPageGuardedPoolAllocator, SmallAllocationsUseAllSlots) {
+  InitMaximumAllocationSize(16, 1 << 20);
+  void *Ptrs[16];
+  for (void *&Ptr : Ptrs) {
+    Ptr = GPA.allocate(1);
+    ASSERT_NE(nullptr, Ptr);
+  }
+  EXPECT_EQ(nullptr, GPA.allocate(1));
+  for (void *Ptr : Ptrs)
+    GPA.deallocate(Ptr);
+}
+
+TEST_F(MultiPageGuardedPoolAllocator, LargeAllocationsAreGuarded) {
+  InitMaximumAllocationSize(16, 1 << 20);
+  const AllocatorState *State = GPA.getAllocatorState();
+  const size_t Size = State->maximumAllocationSize();
+
+  void *Ptrs[16];
+  size_t NumAllocs = 0;
+  while (NumAllocs < 16 && (Ptrs[NumAllocs] = GPA.allocate(Size)))
+    ++NumAllocs;
+  // Only the largest bucket fits these.
+  EXPECT_GE(NumAllocs, 1u);
+  EXPECT_LT(NumAllocs, 16u);
+
+  for (size_t i = 0; i < NumAllocs; ++i) {
+    uintptr_t Ptr = reinterpret_cast<uintptr_t>(Ptrs[i]);
+    EXPECT_TRUE(State->isGuardPage(Ptr - 1));
+    EXPECT_TRUE(State->isGuardPage(Ptr + Size));
+    EXPECT_EQ(Error::BUFFER_UNDERFLOW,
+              __gwp_asan_diagnose_error(State, GPA.getMetadataRegion(),
+                                        Ptr - 1));
+    EXPECT_EQ(Error::BUFFER_OVERFLOW,
+              __gwp_asan_diagnose_error(State, GPA.getMetadataRegion(),
+                                        Ptr + Size));
+  }
+
+  for (size_t i = 0; i < NumAllocs; ++i)
+    GPA.deallocate(Ptrs[i]);
+
+  // Once the single-page slots are used up, small allocations go to larger
+  // slots, whose unused pages guard the allocation as well.
+  uintptr_t SmallPtr = 0;
+  for (NumAllocs = 0; NumAllocs < 16 && !SmallPtr; ++NumAllocs) {
+    Ptrs[NumAllocs] = GPA.allocate(1);
+    ASSERT_NE(nullptr, Ptrs[NumAllocs]);
+    uintptr_t Ptr = reinterpret_cast<uintptr_t>(Ptrs[NumAllocs]);
+    if (State->slotSize(State->getNearestSlot(Ptr)) > State->PageSize)
+      SmallPtr = Ptr;
+  }
+  ASSERT_NE(0u, SmallPtr);
+  const uintptr_t SmallPage = SmallPtr & ~(State->PageSize - 1);
+  if (SmallPage == State->slotToAddr(State->getNearestSlot(SmallPtr))) {
+    // Left-aligned: the next page is unused.
+    EXPECT_FALSE(State->isGuardPage(SmallPage + State->PageSize));
+    EXPECT_EQ(Error::BUFFER_OVERFLOW,
+              __gwp_asan_diagnose_error(State, GPA.getMetadataRegion(),
+                                        SmallPage + State->PageSize));
+  } else {
+    // Right-aligned: the previous page is unused.
+    EXPECT_FALSE(State->isGuardPage(SmallPage - 1));
+    EXPECT_EQ(Error::BUFFER_UNDERFLOW,
+              __gwp_asan_diagnose_error(State, GPA.getMetadataRegion(),
+                                        SmallPage - 1));
+  }
+
+  for (size_t i = 0; i < NumAllocs; ++i)
+    GPA.deallocate(Ptrs[i]);
+}
@@ -52,6 +52,14 @@ TEST(GwpAsanOptionsTest, FailureModes) {
                "MaxSimultaneousAllocations must be > 0");
   RunErrorTest("Enabled=1:SampleRate=0", "SampleRate must be > 0");
   RunErrorTest("Enabled=1:SampleRate=-1", "SampleRate must be > 0");
+  RunErrorTest("Enabled=1:MaximumAllocationSize=-1",
+               "MaximumAllocationSize must be >= 0");
+  RunErrorTest("Enabled=1:TargetSampledAllocationsPerSecond=-1",
+               "TargetSampledAllocationsPerSecond must be >= 0");
+  RunErrorTest("Enabled=1:TargetPoolOccupancyPercent=0",
+               "TargetPoolOccupancyPercent must be in (0, 100]");
+  RunErrorTest("Enabled=1:TargetPoolOccupancyPercent=101",
+               "TargetPoolOccupancyPercent must be in (0, 100]");
   RunErrorTest("Enabled=", "Invalid boolean value '' for option 'Enabled'");
   RunErrorTest("==", "Unknown option '=='");
   RunErrorTest("Enabled==0", "Invalid boolean value '=0' for option 'Enabled'");
@@ -0,0 +1,129 @@
+//===-- slot_scalability.cpp ------------------------------------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+
+#include "gwp_asan/tests/harness.h"
+
+// Note: Compilation of <atomic> and <thread> are extremely expensive for
+// non-opt builds of clang.
+#include <atomic>
+#include <chrono>
+#include <stdio.h>
+#include <thread>
+#include <vector>
+
+// Each thread keeps `NumLive` allocations alive, and repeatedly frees and
+// replaces them. Every allocation is tagged with its owner, so that a slot
+// handed out twice is noticed.
+static void allocateDeallocateTask(gwp_asan::GuardedPoolAllocator *GPA,
+                                   std::atomic<bool> *StartingGun,
+                                   unsigned ThreadID, unsigned NumLive,
+                                   unsigned NumIterations,
+                                   std::atomic<unsigned> *NumFailures) {
+  std::vector<volatile unsigned *> Live(NumLive, nullptr);
+  while (!*StartingGun) {
+    // Wait for starting gun.
+  }
+
+  for (unsigned i = 0; i < NumIterations; ++i) {
+    volatile unsigned *&Ptr = Live[i % NumLive];
+    if (Ptr) {
+      if (*Ptr != ThreadID)
+        ++*NumFailures;
+      *Ptr = 0;
+      GPA->deallocate(const_cast<unsigned *>(Ptr));
+    }
+    Ptr = reinterpret_cast<volatile unsigned *>(GPA->allocate(sizeof(*Ptr)));
+    if (!Ptr) {
+      ++*NumFailures;
+      continue;
+    }
+    // Slots are handed out zeroed, like fresh pages.
+    if (*Ptr != 0)
+      ++*NumFailures;
+    *Ptr = ThreadID;
+  }
+
+  for (volatile unsigned *Ptr : Live) {
+    if (!Ptr)
+      continue;
+    if (*Ptr != ThreadID)
+      ++*NumFailures;
+    *Ptr = 0;
+    GPA->deallocate(const_cast<unsigned *>(Ptr));
+  }
+}
+
+// Runs `NumThreads` threads doing `NumIterations` allocate/deallocate pairs
+// each, and returns the elapsed time in seconds.
+static double runSlotTest(gwp_asan::GuardedPoolAllocator *GPA,
+                          unsigned NumSlots, unsigned NumThreads,
+                          unsigned NumIterations) {
+  // Keep the pool three quarters full, so that allocations never fail.
+  const unsigned NumLive = NumSlots * 3 / 4 / NumThreads;
+
+  std::atomic<bool> StartingGun{false};
+  std::atomic<unsigned> NumFailures{0};
+  std::vector<std::thread> Threads;
+  for (unsigned i = 0; i < NumThreads; ++i)
+    Threads.emplace_back(allocateDeallocateTask, GPA, &StartingGun, i + 1,
+                         NumLive, NumIterations, &NumFailures);
+
+  auto Start = std::chrono::steady_clock::now();
+  StartingGun = true;
+  for (auto &T : Threads)
+    T.join();
+  auto End = std::chrono::steady_clock::now();
+
+  EXPECT_EQ(0u, NumFailures.load());
+  return std::chrono::duration<double>(End - Start).count();
+}
+
+static unsigned getNumThreads() {
+  unsigned NumThreads = std::thread::hardware_concurrency();
+  if (NumThreads < 2)
+    return 2;
+  return NumThreads > 8 ? 8 : NumThreads;
+}
+
+// Each thread replaces each of its live allocations once.
+static void runSlotReuseTest(gwp_asan::GuardedPoolAllocator *GPA,
+                             unsigned NumSlots) {
+  const unsigned NumThreads = getNumThreads();
+  runSlotTest(GPA, NumSlots, NumThreads, 2 * (NumSlots * 3 / 4 / NumThreads));
+}
+
+TEST_F(CustomGuardedPoolAllocator, SlotReuse64) {
+  InitNumSlots(64);
+  runSlotReuseTest(&GPA, 64);
+}
+
+TEST_F(CustomGuardedPoolAllocator, SlotReuse16384) {
+  InitNumSlots(16384);
+  runSlotReuseTest(&GPA, 16384);
+}
+
+// Prints allocate/deallocate throughput. Run manually with
+// --gtest_also_run_disabled_tests.
+static void runScalabilityTest(gwp_asan::GuardedPoolAllocator *GPA,
+                               unsigned NumSlots) {
+  constexpr unsigned kNumIterations = 20000;
+  const unsigned NumThreads = getNumThreads();
+  const double Seconds = runSlotTest(GPA, NumSlots, NumThreads, kNumIterations);
+  printf("%u slots, %u threads: %.0f allocate/deallocate pairs per second\n",
+         NumSlots, NumThreads, NumThreads * kNumIterations / Seconds);
+}
+
+TEST_F(CustomGuardedPoolAllocator, DISABLED_Scalability64) {
+  InitNumSlots(64);
+  runScalabilityTest(&GPA, 64);
+}
+
+TEST_F(CustomGuardedPoolAllocator, DISABLED_Scalability16384) {
+  InitNumSlots(16384);
+  runScalabilityTest(&GPA, 16384);
+}
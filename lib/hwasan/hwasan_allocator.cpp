@@ -224,6 +224,63 @@ static bool CheckInvalidFree(StackTrace *stack, void *untagged_ptr,
   return false;
 }
 
+void PushHeapAllocationRecord(HeapAllocationsRingBuffer *rb,
+                              const HeapAllocationRecord &h) {
+  using E = HeapAllocationEntry;
+  uptr granule = UntagAddr(h.tagged_addr) >> kShadowScale;
+  uptr size = h.requested_size;
+  E e = {};
+  e.record.tag = GetTagFromPointer(h.tagged_addr);
+  e.record.addr_granule = granule & ((1ULL << E::kAddrGranuleBits) - 1);
+  if ((granule >> E::kAddrGranuleBits) || size >= E::kSizeEscape ||
+      (h.alloc_context_id >> E::kContextIdBits) ||
+      (h.free_context_id >> E::kContextIdBits)) {
+    E ext = {};
+    ext.extension.is_extension = 1;
+    ext.extension.alloc_context_id = h.alloc_context_id;
+    ext.extension.free_context_id = h.free_context_id;
+    ext.extension.requested_size = size;
+    ext.extension.addr_granule_high = granule >> E::kAddrGranuleBits;
+    rb->push(ext);
+    size = E::kSizeEscape;
+  } else {
+    e.record.alloc_context_id = h.alloc_context_id;
+    e.record.free_context_id = h.free_context_id;
+  }
+  e.record.requested_size_low = size & ((1U << 11) - 1);
+  e.record.requested_size_high = size >> 11;
+  rb->push(e);
+}
+
+bool GetHeapAllocationRecord(const HeapAllocationsRingBuffer *rb, uptr idx,
+                             HeapAllocationRecord *h) {
+  using E = HeapAllocationEntry;
+  E e = (*rb)[idx];
+  if (e.record.is_extension)
+    return false;
+  uptr granule = e.record.addr_granule;
+  uptr size =
+      ((uptr)e.record.requested_size_high << 11) | e.record.requested_size_low;
+  if (size == E::kSizeEscape) {
+    // The extension is the next older entry, unless it was overwritten.
+    if (idx + 1 >= rb->size())
+      return false;
+    E ext = (*rb)[idx + 1];
+    if (!ext.extension.is_extension)
+      return false;
+    granule |= (uptr)ext.extension.addr_granule_high << E::kAddrGranuleBits;
+    size = ext.extension.requested_size;
+    h->alloc_context_id = ext.extension.alloc_context_id;
+    h->free_context_id = ext.extension.free_context_id;
+  } else {
+    h->alloc_context_id = e.record.alloc_context_id;
+    h->free_context_id = e.record.free_context_id;
+  }
+  h->tagged_addr = AddTagToPointer(granule << kShadowScale, e.record.tag);
+  h->requested_size = size;
+  return true;
+}
+
 static void HwasanDeallocate(StackTrace *stack, void *tagged_ptr) {
   CHECK(tagged_ptr);
   RunFreeHooks(tagged_ptr);
@@ -298,8 +355,9 @@ static void HwasanDeallocate(StackTrace *stack, void *tagged_ptr) {
   if (t) {
     allocator.Deallocate(t->allocator_cache(), aligned_ptr);
     if (auto *ha = t->heap_allocations())
-      ha->push({reinterpret_cast<uptr>(tagged_ptr), alloc_context_id,
-                free_context_id, static_cast<u32>(orig_size)});
+      PushHeapAllocationRecord(ha, {reinterpret_cast<uptr>(tagged_ptr),
+                                    alloc_context_id, free_context_id,
+                                    orig_size});
   } else {
     SpinMutexLock l(&fallback_mutex);
     AllocatorCache *cache = &fallback_allocator_cache;
@@ -96,17 +96,53 @@ class HwasanChunkView {
 HwasanChunkView FindHeapChunkByAddress(uptr address);
 
 // Information about one (de)allocation that happened in the past.
-// These are recorded in a thread-local ring buffer.
-// TODO: this is currently 24 bytes (20 bytes + alignment).
-// Compress it to 16 bytes or extend it to be more useful.
 struct HeapAllocationRecord {
   uptr tagged_addr;
   u32  alloc_context_id;
   u32  free_context_id;
-  u32  requested_size;
+  uptr requested_size;
 };
 
-typedef RingBuffer<HeapAllocationRecord> HeapAllocationsRingBuffer;
+// HeapAllocationRecords are kept in a thread-local ring buffer of 16-byte
+// entries. A record takes one entry when the chunk address fits a 44-bit
+// granule index (48-bit VA), the size fits kSizeBits and both stack depot ids
+// fit kContextIdBits. Otherwise the entry has the kSizeEscape size and the
+// exact values live in an extension entry pushed right before it.
+union HeapAllocationEntry {
+  static const unsigned kAddrGranuleBits = 44;
+  static const unsigned kSizeBits = 23;
+  static const unsigned kContextIdBits = 26;
+  static const uptr kSizeEscape = (1UL << kSizeBits) - 1;
+
+  struct {
+    u64 is_extension : 1;
+    u64 tag : 8;
+    u64 addr_granule : kAddrGranuleBits;
+    u64 requested_size_low : 11;
+    u64 requested_size_high : kSizeBits - 11;
+    u64 alloc_context_id : kContextIdBits;
+    u64 free_context_id : kContextIdBits;
+  } record;
+  struct {
+    u64 is_extension : 1;
+    u64 alloc_context_id : 31;
+    u64 free_context_id : 31;
+    u64 unused : 1;
+    u64 requested_size : 48;
+    u64 addr_granule_high : 64 - kAddrGranuleBits - kShadowScale;
+  } extension;
+};
+COMPILER_CHECK(sizeof(HeapAllocationEntry) == 16);
+COMPILER_CHECK(kMaxAllowedMallocSize < (1ULL << 48));
+
+typedef RingBuffer<HeapAllocationEntry> HeapAllocationsRingBuffer;
+
+void PushHeapAllocationRecord(HeapAllocationsRingBuffer *rb,
+                              const HeapAllocationRecord &h);
+// Returns false if the entry at idx is an extension or lost its extension
+// to the ring wrapping around.
+bool GetHeapAllocationRecord(const HeapAllocationsRingBuffer *rb, uptr idx,
+                             HeapAllocationRecord *h);
 
 void GetAllocatorStats(AllocatorStatCounters s);
 
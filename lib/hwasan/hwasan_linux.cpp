@@ -411,6 +411,23 @@ void Thread::InitStackAndTls(const InitState *) {
   tls_end_ = tls_begin_ + tls_size;
 }
 
+// Fills shadow with a tag. Shadow of a granule-aligned chunk is usually not
+// 16-byte aligned, which makes internal_memset fall back to a byte loop, so
+// write unaligned head and tail bytes separately and the rest in words.
+static void FillShadow(uptr shadow, uptr size, tag_t tag) {
+  uptr end = shadow + size;
+  uptr word_beg = RoundUpTo(shadow, sizeof(u64));
+  uptr word_end = RoundDownTo(end, sizeof(u64));
+  if (word_beg >= word_end) {
+    internal_memset((void *)shadow, tag, size);
+    return;
+  }
+  u64 v = tag * 0x0101010101010101ULL;
+  for (; shadow < word_beg; ++shadow) *(u8 *)shadow = tag;
+  for (uptr w = word_beg; w < word_end; w += sizeof(u64)) *(u64 *)w = v;
+  for (uptr b = word_end; b < end; ++b) *(u8 *)b = tag;
+}
+
 uptr TagMemoryAligned(uptr p, uptr size, tag_t tag) {
   CHECK(IsAligned(p, kShadowAlignment));
   CHECK(IsAligned(size, kShadowAlignment));
@@ -423,14 +440,13 @@ uptr TagMemoryAligned(uptr p, uptr size, tag_t tag) {
   uptr threshold = common_flags()->clear_shadow_mmap_threshold;
   if (SANITIZER_LINUX &&
       UNLIKELY(page_end >= page_start + threshold && tag == 0)) {
-    internal_memset((void *)shadow_start, tag, page_start - shadow_start);
-    internal_memset((void *)page_end, tag,
-                    shadow_start + shadow_size - page_end);
+    FillShadow(shadow_start, page_start - shadow_start, tag);
+    FillShadow(page_end, shadow_start + shadow_size - page_end, tag);
     // For an anonymous private mapping MADV_DONTNEED will return a zero page on
     // Linux.
     ReleaseMemoryPagesToOSAndZeroFill(page_start, page_end);
   } else {
-    internal_memset((void *)shadow_start, tag, shadow_size);
+    FillShadow(shadow_start, shadow_size, tag);
   }
   return AddTagToPointer(p, tag);
 }
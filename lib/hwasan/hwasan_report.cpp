@@ -147,7 +147,9 @@ static bool FindHeapAllocation(HeapAllocationsRingBuffer *rb, uptr tagged_addr,
   *num_matching_addrs = 0;
   *num_matching_addrs_4b = 0;
   for (uptr i = 0, size = rb->size(); i < size; i++) {
-    auto h = (*rb)[i];
+    HeapAllocationRecord h;
+    if (!GetHeapAllocationRecord(rb, i, &h))
+      continue;
     if (h.tagged_addr <= tagged_addr &&
         h.tagged_addr + h.requested_size > tagged_addr) {
       *har = h;
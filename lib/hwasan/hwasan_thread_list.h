@@ -71,10 +71,18 @@ struct ThreadStats {
   uptr total_stack_size;
 };
 
+// Thread creation and destruction take no locks, as programs that churn
+// through thread pools would contend on them. Each element of the storage is
+// a slot with a fixed index. Slots are carved out of the free space with an
+// atomic bump pointer, and recycled through a lock-free stack of free slot
+// indices, whose head is tagged with a generation counter against ABA. Live
+// threads are found by scanning the slots that were ever handed out; a visitor
+// pins the slot it is looking at, and a dying thread waits for its slot to be
+// unpinned before it is torn down.
 class HwasanThreadList {
  public:
   HwasanThreadList(uptr storage, uptr size)
-      : free_space_(storage), free_space_end_(storage + size) {
+      : storage_(storage), free_space_end_(storage + size) {
     // [storage, storage + size) is used as a vector of
     // thread_alloc_size_-sized, ring_buffer_size_*2-aligned elements.
     // Each element contains
@@ -83,28 +91,23 @@ class HwasanThreadList {
     ring_buffer_size_ = RingBufferSize();
     thread_alloc_size_ =
         RoundUpTo(ring_buffer_size_ + sizeof(Thread), ring_buffer_size_ * 2);
+    atomic_store_relaxed(&free_space_, storage);
+    max_slots_ = size / thread_alloc_size_;
+    slots_ = (Slot *)MmapNoReserveOrDie(max_slots_ * sizeof(Slot),
+                                        "hwasan thread slots");
   }
 
   Thread *CreateCurrentThread(const Thread::InitState *state = nullptr) {
-    Thread *t = nullptr;
-    {
-      SpinMutexLock l(&free_list_mutex_);
-      if (!free_list_.empty()) {
-        t = free_list_.back();
-        free_list_.pop_back();
-      }
-    }
+    Thread *t = PopFreeThread();
     if (t) {
       uptr start = (uptr)t - ring_buffer_size_;
       internal_memset((void *)start, 0, ring_buffer_size_ + sizeof(Thread));
     } else {
       t = AllocThread();
     }
-    {
-      SpinMutexLock l(&live_list_mutex_);
-      live_list_.push_back(t);
-    }
     t->Init((uptr)t - ring_buffer_size_, ring_buffer_size_, state);
+    // Publish the thread to VisitAllLiveThreads() once it is initialized.
+    atomic_store(&slots_[SlotIndex(t)].state, kSlotLive, memory_order_release);
     AddThreadStats(t);
     return t;
   }
@@ -114,26 +117,17 @@ class HwasanThreadList {
     ReleaseMemoryPagesToOS(start, start + thread_alloc_size_);
   }
 
-  void RemoveThreadFromLiveList(Thread *t) {
-    SpinMutexLock l(&live_list_mutex_);
-    for (Thread *&t2 : live_list_)
-      if (t2 == t) {
-        // To remove t2, copy the last element of the list in t2's position, and
-        // pop_back(). This works even if t2 is itself the last element.
-        t2 = live_list_.back();
-        live_list_.pop_back();
-        return;
-      }
-    CHECK(0 && "thread not found in live list");
-  }
-
   void ReleaseThread(Thread *t) {
     RemoveThreadStats(t);
+    atomic_uint32_t *state = &slots_[SlotIndex(t)].state;
+    u32 was = atomic_fetch_sub(state, kSlotLive, memory_order_relaxed);
+    CHECK((was & kSlotLive) && "thread not found in live list");
+    // Wait for VisitAllLiveThreads() to be done with the thread.
+    while (atomic_load(state, memory_order_acquire))
+      internal_sched_yield();
     t->Destroy();
     DontNeedThread(t);
-    RemoveThreadFromLiveList(t);
-    SpinMutexLock l(&free_list_mutex_);
-    free_list_.push_back(t);
+    PushFreeThread(t);
   }
 
   Thread *GetThreadByBufferAddress(uptr p) {
@@ -148,55 +142,114 @@ class HwasanThreadList {
     return res;
   }
 
+  // Threads may be created or destroyed concurrently. Those are visited or
+  // not, but a thread is never visited before it is initialized, and is not
+  // destroyed while it is being visited.
   template <class CB>
   void VisitAllLiveThreads(CB cb) {
-    SpinMutexLock l(&live_list_mutex_);
-    for (Thread *t : live_list_) cb(t);
+    uptr used = (atomic_load(&free_space_, memory_order_acquire) - storage_) /
+                thread_alloc_size_;
+    for (uptr i = 0; i < Min(used, max_slots_); i++) {
+      atomic_uint32_t *state = &slots_[i].state;
+      u32 s = atomic_load(state, memory_order_acquire);
+      while ((s & kSlotLive) &&
+             !atomic_compare_exchange_weak(state, &s, s + kSlotVisitor,
+                                           memory_order_acquire)) {
+      }
+      if (!(s & kSlotLive))
+        continue;
+      cb(SlotThread(i));
+      atomic_fetch_sub(state, kSlotVisitor, memory_order_release);
+    }
   }
 
   void AddThreadStats(Thread *t) {
-    SpinMutexLock l(&stats_mutex_);
-    stats_.n_live_threads++;
-    stats_.total_stack_size += t->stack_size();
+    atomic_fetch_add(&n_live_threads_, 1, memory_order_relaxed);
+    atomic_fetch_add(&total_stack_size_, t->stack_size(),
+                     memory_order_relaxed);
   }
 
   void RemoveThreadStats(Thread *t) {
-    SpinMutexLock l(&stats_mutex_);
-    stats_.n_live_threads--;
-    stats_.total_stack_size -= t->stack_size();
+    atomic_fetch_sub(&n_live_threads_, 1, memory_order_relaxed);
+    atomic_fetch_sub(&total_stack_size_, t->stack_size(),
+                     memory_order_relaxed);
   }
 
   ThreadStats GetThreadStats() {
-    SpinMutexLock l(&stats_mutex_);
-    return stats_;
+    return {atomic_load_relaxed(&n_live_threads_),
+            atomic_load_relaxed(&total_stack_size_)};
   }
 
   uptr GetRingBufferSize() const { return ring_buffer_size_; }
 
  private:
+  struct Slot {
+    // Index plus one of the next slot in the free stack, or zero.
+    atomic_uint32_t next_free;
+    // kSlotLive while the thread is live, plus kSlotVisitor for each
+    // VisitAllLiveThreads() call that is looking at it.
+    atomic_uint32_t state;
+  };
+  static const u32 kSlotLive = 1;
+  static const u32 kSlotVisitor = 2;
+
+  uptr SlotIndex(Thread *t) const {
+    return ((uptr)t - ring_buffer_size_ - storage_) / thread_alloc_size_;
+  }
+
+  Thread *SlotThread(uptr i) const {
+    return (Thread *)(storage_ + i * thread_alloc_size_ + ring_buffer_size_);
+  }
+
   Thread *AllocThread() {
-    SpinMutexLock l(&free_space_mutex_);
-    uptr align = ring_buffer_size_ * 2;
-    CHECK(IsAligned(free_space_, align));
-    Thread *t = (Thread *)(free_space_ + ring_buffer_size_);
-    free_space_ += thread_alloc_size_;
-    CHECK(free_space_ <= free_space_end_ && "out of thread memory");
-    return t;
+    uptr start = atomic_fetch_add(&free_space_, thread_alloc_size_,
+                                  memory_order_relaxed);
+    CHECK(IsAligned(start, ring_buffer_size_ * 2));
+    CHECK(start + thread_alloc_size_ <= free_space_end_ &&
+          "out of thread memory");
+    return (Thread *)(start + ring_buffer_size_);
+  }
+
+  // The head of the free stack holds the index plus one of the top slot in
+  // its low 32 bits, and a generation counter in its high 32 bits.
+  Thread *PopFreeThread() {
+    u64 head = atomic_load(&free_head_, memory_order_acquire);
+    for (;;) {
+      u32 top = (u32)head;
+      if (!top)
+        return nullptr;
+      u64 next = atomic_load_relaxed(&slots_[top - 1].next_free);
+      u64 new_head = ((head >> 32) + 1) << 32 | next;
+      if (atomic_compare_exchange_weak(&free_head_, &head, new_head,
+                                       memory_order_acquire))
+        return SlotThread(top - 1);
+    }
+  }
+
+  void PushFreeThread(Thread *t) {
+    uptr i = SlotIndex(t);
+    u64 head = atomic_load_relaxed(&free_head_);
+    for (;;) {
+      atomic_store_relaxed(&slots_[i].next_free, (u32)head);
+      u64 new_head = ((head >> 32) + 1) << 32 | (i + 1);
+      if (atomic_compare_exchange_weak(&free_head_, &head, new_head,
+                                       memory_order_release))
+        return;
+    }
   }
 
-  SpinMutex free_space_mutex_;
-  uptr free_space_;
+  uptr storage_;
+  atomic_uintptr_t free_space_;
   uptr free_space_end_;
   uptr ring_buffer_size_;
   uptr thread_alloc_size_;
 
-  SpinMutex free_list_mutex_;
-  InternalMmapVector<Thread *> free_list_;
-  SpinMutex live_list_mutex_;
-  InternalMmapVector<Thread *> live_list_;
+  Slot *slots_;
+  uptr max_slots_;
+  atomic_uint64_t free_head_ = {};
 
-  ThreadStats stats_;
-  SpinMutex stats_mutex_;
+  atomic_uintptr_t n_live_threads_ = {};
+  atomic_uintptr_t total_stack_size_ = {};
 };
 
 void InitThreadList(uptr storage, uptr size);
@@ -292,6 +292,24 @@ void LsanMetadata::set_tag(ChunkTag value) {
   reinterpret_cast<ChunkMetadata *>(metadata_)->tag = value;
 }
 
+bool LsanMetadata::compare_exchange_tag(ChunkTag cmp, ChunkTag xchg) {
+  // The tag is a bitfield in the first 32 bits of the metadata. The other
+  // bits there do not change while the world is stopped, so compare and swap
+  // the whole word.
+  ChunkMetadata *m = reinterpret_cast<ChunkMetadata *>(metadata_);
+  atomic_uint32_t *word = reinterpret_cast<atomic_uint32_t *>(m);
+  u32 old_word = atomic_load_relaxed(word);
+  ChunkMetadata tmp = *m;
+  internal_memcpy(&tmp, &old_word, sizeof(old_word));
+  if (tmp.tag != cmp)
+    return false;
+  tmp.tag = xchg;
+  u32 new_word;
+  internal_memcpy(&new_word, &tmp, sizeof(new_word));
+  return atomic_compare_exchange_strong(word, &old_word, new_word,
+                                        memory_order_relaxed);
+}
+
 uptr LsanMetadata::requested_size() const {
   return reinterpret_cast<ChunkMetadata *>(metadata_)->requested_size;
 }
@@ -304,6 +322,10 @@ void ForEachChunk(ForEachChunkCallback callback, void *arg) {
   allocator.ForEachChunk(callback, arg);
 }
 
+void ForEachChunkBatch(ForEachChunkBatchCallback callback, void *arg) {
+  allocator.ForEachChunkBatch(callback, arg);
+}
+
 IgnoreObjectResult IgnoreObjectLocked(const void *p) {
   void *chunk = allocator.GetBlockBegin(p);
   if (!chunk || p < chunk) return kIgnoreObjectInvalid;
@@ -259,6 +259,62 @@ static inline bool MaybeUserPointer(uptr p) {
 #  endif
 }
 
+// Range of addresses that may point into allocated chunks. Only set while
+// chunks are classified; everything is a candidate otherwise. ScanGlobalRange()
+// skips it, as the lower bound would keep the lowest chunk reachable.
+static struct {
+  uptr begin;
+  uptr end;
+} heap_range = {0, ~(uptr)0};
+
+// Number of words checked against the heap range at a time. The check is
+// written so that the compiler can vectorize it.
+static const uptr kScanFilterWords = 8;
+
+static ALWAYS_INLINE bool MaybeHeapPointer(uptr p, uptr heap_begin,
+                                           uptr heap_size) {
+  return p - heap_begin < heap_size;
+}
+
+// Checks whether the word at |pp| points into a chunk and, if so, tags the
+// chunk and adds it to |frontier|.
+static ALWAYS_INLINE void ScanWordForPointer(uptr pp, uptr begin,
+                                             Frontier *frontier,
+                                             ChunkTag tag) {
+  void *p = *reinterpret_cast<void **>(pp);
+  if (!MaybeUserPointer(reinterpret_cast<uptr>(p)))
+    return;
+  uptr chunk = PointsIntoChunk(p);
+  if (!chunk)
+    return;
+  // Pointers to self don't count. This matters when tag == kIndirectlyLeaked.
+  if (chunk == begin)
+    return;
+  LsanMetadata m(chunk);
+  ChunkTag old_tag = m.tag();
+  if (old_tag == kReachable || old_tag == kIgnored)
+    return;
+
+  // Do this check relatively late so we can log only the interesting cases.
+  if (!flags()->use_poisoned && WordIsPoisoned(pp)) {
+    LOG_POINTERS(
+        "%p is poisoned: ignoring %p pointing into chunk %p-%p of size "
+        "%zu.\n",
+        (void *)pp, p, (void *)chunk, (void *)(chunk + m.requested_size()),
+        m.requested_size());
+    return;
+  }
+
+  // With parallel marking, another thread may have tagged the chunk since.
+  if (!m.compare_exchange_tag(old_tag, tag))
+    return;
+  LOG_POINTERS("%p: found %p pointing into chunk %p-%p of size %zu.\n",
+               (void *)pp, p, (void *)chunk,
+               (void *)(chunk + m.requested_size()), m.requested_size());
+  if (frontier)
+    frontier->push_back(chunk);
+}
+
 // Scans the memory range, looking for byte patterns that point into allocator
 // chunks. Marks those chunks with |tag| and adds them to |frontier|.
 // There are two usage modes for this function: finding reachable chunks
@@ -269,59 +325,97 @@ void ScanRangeForPointers(uptr begin, uptr end, Frontier *frontier,
                           const char *region_type, ChunkTag tag) {
   CHECK(tag == kReachable || tag == kIndirectlyLeaked);
   const uptr alignment = flags()->pointer_alignment();
+  const uptr heap_begin = heap_range.begin;
+  const uptr heap_size = heap_range.end - heap_begin;
   LOG_POINTERS("Scanning %s range %p-%p.\n", region_type, (void *)begin,
                (void *)end);
   uptr pp = begin;
   if (pp % alignment)
     pp = pp + alignment - pp % alignment;
+  if (alignment == sizeof(uptr)) {
+    // Most words are not pointers into the heap. Skip blocks of them with
+    // a branch-free range check before the expensive per-word lookups.
+    const uptr kBlockSize = kScanFilterWords * sizeof(uptr);
+    for (; pp + kBlockSize <= end; pp += kBlockSize) {
+      const uptr *words = reinterpret_cast<const uptr *>(pp);
+      bool any = false;
+      for (uptr i = 0; i < kScanFilterWords; i++)
+        any |= MaybeHeapPointer(words[i], heap_begin, heap_size);
+      if (!any)
+        continue;
+      for (uptr i = 0; i < kScanFilterWords; i++) {
+        if (MaybeHeapPointer(words[i], heap_begin, heap_size))
+          ScanWordForPointer(pp + i * sizeof(uptr), begin, frontier, tag);
+      }
+    }
+  }
   for (; pp + sizeof(void *) <= end; pp += alignment) {
-    void *p = *reinterpret_cast<void **>(pp);
-    if (!MaybeUserPointer(reinterpret_cast<uptr>(p)))
-      continue;
-    uptr chunk = PointsIntoChunk(p);
-    if (!chunk)
-      continue;
-    // Pointers to self don't count. This matters when tag == kIndirectlyLeaked.
-    if (chunk == begin)
-      continue;
-    LsanMetadata m(chunk);
-    if (m.tag() == kReachable || m.tag() == kIgnored)
-      continue;
+    uptr p = *reinterpret_cast<uptr *>(pp);
+    if (MaybeHeapPointer(p, heap_begin, heap_size))
+      ScanWordForPointer(pp, begin, frontier, tag);
+  }
+}
 
-    // Do this check relatively late so we can log only the interesting cases.
-    if (!flags()->use_poisoned && WordIsPoisoned(pp)) {
-      LOG_POINTERS(
-          "%p is poisoned: ignoring %p pointing into chunk %p-%p of size "
-          "%zu.\n",
-          (void *)pp, p, (void *)chunk, (void *)(chunk + m.requested_size()),
-          m.requested_size());
+// Set during incremental leak checks while scanning roots that keep their
+// contents between checks: global and root regions, and reachable chunks.
+static bool scan_dirty_only = false;
+
+// Scans the pages of the range that were written since the previous leak
+// check.
+static void ScanDirtyRangeForPointers(uptr begin, uptr end, Frontier *frontier,
+                                      const char *region_type) {
+  const uptr page_size = GetPageSizeCached();
+  uptr run_begin = 0;
+  bool in_run = false;
+  for (uptr page = RoundDownTo(begin, page_size); page < end;
+       page += page_size) {
+    if (IsSoftDirtyPage(page)) {
+      if (!in_run)
+        run_begin = Max(page, begin);
+      in_run = true;
       continue;
     }
-
-    m.set_tag(tag);
-    LOG_POINTERS("%p: found %p pointing into chunk %p-%p of size %zu.\n",
-                 (void *)pp, p, (void *)chunk,
-                 (void *)(chunk + m.requested_size()), m.requested_size());
-    if (frontier)
-      frontier->push_back(chunk);
+    if (in_run) {
+      // Let unaligned pointers cross into the clean page.
+      ScanRangeForPointers(run_begin, Min(page + sizeof(uptr) - 1, end),
+                           frontier, region_type, kReachable);
+      in_run = false;
+    }
   }
+  if (in_run)
+    ScanRangeForPointers(run_begin, end, frontier, region_type, kReachable);
+}
+
+static void ScanRootRangeForPointers(uptr begin, uptr end, Frontier *frontier,
+                                     const char *region_type) {
+  if (scan_dirty_only)
+    ScanDirtyRangeForPointers(begin, end, frontier, region_type);
+  else
+    ScanRangeForPointers(begin, end, frontier, region_type, kReachable);
 }
 
-// Scans a global range for pointers
+// Scans a global range for pointers. The allocator object and the heap range
+// are globals, but not roots.
 void ScanGlobalRange(uptr begin, uptr end, Frontier *frontier) {
-  uptr allocator_begin = 0, allocator_end = 0;
-  GetAllocatorGlobalRange(&allocator_begin, &allocator_end);
-  if (begin <= allocator_begin && allocator_begin < end) {
-    CHECK_LE(allocator_begin, allocator_end);
-    CHECK_LE(allocator_end, end);
-    if (begin < allocator_begin)
-      ScanRangeForPointers(begin, allocator_begin, frontier, "GLOBAL",
-                           kReachable);
-    if (allocator_end < end)
-      ScanRangeForPointers(allocator_end, end, frontier, "GLOBAL", kReachable);
-  } else {
-    ScanRangeForPointers(begin, end, frontier, "GLOBAL", kReachable);
+  uptr excluded_begin[2], excluded_end[2];
+  GetAllocatorGlobalRange(&excluded_begin[0], &excluded_end[0]);
+  excluded_begin[1] = reinterpret_cast<uptr>(&heap_range);
+  excluded_end[1] = excluded_begin[1] + sizeof(heap_range);
+  if (excluded_begin[1] < excluded_begin[0]) {
+    Swap(excluded_begin[0], excluded_begin[1]);
+    Swap(excluded_end[0], excluded_end[1]);
+  }
+  for (uptr i = 0; i < 2; i++) {
+    if (excluded_begin[i] < begin || excluded_begin[i] >= end)
+      continue;
+    CHECK_LE(excluded_begin[i], excluded_end[i]);
+    CHECK_LE(excluded_end[i], end);
+    if (begin < excluded_begin[i])
+      ScanRootRangeForPointers(begin, excluded_begin[i], frontier, "GLOBAL");
+    begin = excluded_end[i];
   }
+  if (begin < end)
+    ScanRootRangeForPointers(begin, end, frontier, "GLOBAL");
 }
 
 void ForEachExtraStackRangeCb(uptr begin, uptr end, void *arg) {
@@ -496,8 +590,8 @@ void ScanRootRegion(Frontier *frontier, const RootRegion &root_region,
                (void *)region_begin, (void *)region_end,
                is_readable ? "readable" : "unreadable");
   if (is_readable)
-    ScanRangeForPointers(intersection_begin, intersection_end, frontier, "ROOT",
-                         kReachable);
+    ScanRootRangeForPointers(intersection_begin, intersection_end, frontier,
+                             "ROOT");
 }
 
 static void ProcessRootRegion(Frontier *frontier,
@@ -518,84 +612,215 @@ static void ProcessRootRegions(Frontier *frontier) {
     ProcessRootRegion(frontier, root_regions[i]);
 }
 
-static void FloodFillTag(Frontier *frontier, ChunkTag tag) {
+// Shared state of a parallel flood fill. Each worker scans chunks from its
+// own frontier. Workers that run out of chunks take batches from |pool|, and
+// busy workers donate half of their frontier to it while others are idle.
+// The fill is done when the pool is empty and all workers are idle.
+struct ParallelMarkState {
+  static const uptr kBatch = 256;
+
+  ChunkTag tag;
+  SpinMutex mu;
+  Frontier pool;
+  uptr workers;
+  atomic_uintptr_t idle;
+  bool done;
+};
+
+static void ScanChunks(Frontier *frontier, ChunkTag tag,
+                       ParallelMarkState *state) {
   while (frontier->size()) {
     uptr next_chunk = frontier->back();
     frontier->pop_back();
     LsanMetadata m(next_chunk);
     ScanRangeForPointers(next_chunk, next_chunk + m.requested_size(), frontier,
                          "HEAP", tag);
+    if (state && frontier->size() >= 2 * ParallelMarkState::kBatch &&
+        atomic_load_relaxed(&state->idle)) {
+      SpinMutexLock l(&state->mu);
+      uptr keep = frontier->size() / 2;
+      for (uptr i = keep; i < frontier->size(); i++)
+        state->pool.push_back((*frontier)[i]);
+      frontier->resize(keep);
+    }
   }
 }
 
-// ForEachChunk callback. If the chunk is marked as leaked, marks all chunks
-// which are reachable from it as indirectly leaked.
-static void MarkIndirectlyLeakedCb(uptr chunk, void *arg) {
-  chunk = GetUserBegin(chunk);
-  LsanMetadata m(chunk);
-  if (m.allocated() && m.tag() != kReachable) {
-    ScanRangeForPointers(chunk, chunk + m.requested_size(),
-                         /* frontier */ nullptr, "HEAP", kIndirectlyLeaked);
+static void ParallelMarkWorker(void *arg) {
+  ParallelMarkState *state = reinterpret_cast<ParallelMarkState *>(arg);
+  Frontier frontier;
+  {
+    SpinMutexLock l(&state->mu);
+    state->workers++;
+    atomic_store_relaxed(&state->idle, atomic_load_relaxed(&state->idle) + 1);
+  }
+  for (;;) {
+    {
+      SpinMutexLock l(&state->mu);
+      if (state->done)
+        return;
+      uptr idle = atomic_load_relaxed(&state->idle);
+      if (state->pool.size()) {
+        uptr n = Min((uptr)state->pool.size(), ParallelMarkState::kBatch);
+        for (uptr i = state->pool.size() - n; i < state->pool.size(); i++)
+          frontier.push_back(state->pool[i]);
+        state->pool.resize(state->pool.size() - n);
+        atomic_store_relaxed(&state->idle, idle - 1);
+      } else if (idle == state->workers) {
+        state->done = true;
+        return;
+      }
+    }
+    if (!frontier.size()) {
+      internal_sched_yield();
+      continue;
+    }
+    ScanChunks(&frontier, state->tag, state);
+    SpinMutexLock l(&state->mu);
+    atomic_store_relaxed(&state->idle, atomic_load_relaxed(&state->idle) + 1);
   }
 }
 
-static void IgnoredSuppressedCb(uptr chunk, void *arg) {
-  CHECK(arg);
-  chunk = GetUserBegin(chunk);
-  LsanMetadata m(chunk);
-  if (!m.allocated() || m.tag() == kIgnored)
+static void FloodFillTag(Frontier *frontier, ChunkTag tag,
+                         uptr mark_threads) {
+  if (mark_threads <= 1 || !frontier->size()) {
+    ScanChunks(frontier, tag, nullptr);
     return;
+  }
+  ParallelMarkState state;
+  state.tag = tag;
+  state.workers = 0;
+  atomic_store_relaxed(&state.idle, 0);
+  state.done = false;
+  state.pool.swap(*frontier);
+  RunMarkWorkers(mark_threads, ParallelMarkWorker, &state);
+  CHECK(state.done);
+  CHECK(!state.pool.size());
+}
 
-  const InternalMmapVector<u32> &suppressed =
-      *static_cast<const InternalMmapVector<u32> *>(arg);
-  uptr idx = InternalLowerBound(suppressed, m.stack_trace_id());
-  if (idx >= suppressed.size() || m.stack_trace_id() != suppressed[idx])
-    return;
+// ForEachChunkBatch callback. If a chunk is marked as leaked, marks all chunks
+// which are reachable from it as indirectly leaked.
+static void MarkIndirectlyLeakedCb(const uptr *chunks, uptr n, void *arg) {
+  for (uptr i = 0; i < n; i++) {
+    uptr chunk = GetUserBegin(chunks[i]);
+    LsanMetadata m(chunk);
+    if (m.allocated() && m.tag() != kReachable) {
+      ScanRangeForPointers(chunk, chunk + m.requested_size(),
+                           /* frontier */ nullptr, "HEAP", kIndirectlyLeaked);
+    }
+  }
+}
 
-  LOG_POINTERS("Suppressed: chunk %p-%p of size %zu.\n", (void *)chunk,
-               (void *)(chunk + m.requested_size()), m.requested_size());
-  m.set_tag(kIgnored);
+struct PrepareChunksParam {
+  Frontier *frontier;
+  const InternalMmapVector<u32> *suppressed_stacks;
+  bool reset_tags;
+  uptr heap_begin;
+  uptr heap_end;
+};
+
+// ForEachChunkBatch callback. Does all per-chunk work needed before roots are
+// scanned in one pass over the heap:
+//  - resets the tags left by a previous check, if asked to;
+//  - ignores chunks allocated from suppressed stacks;
+//  - adds ignored chunks to the frontier;
+//  - extends the heap range to cover the addresses that PointsIntoChunk()
+//    accepts for each chunk.
+static void PrepareChunksCb(const uptr *chunks, uptr n, void *arg) {
+  CHECK(arg);
+  PrepareChunksParam *param = reinterpret_cast<PrepareChunksParam *>(arg);
+  const InternalMmapVector<u32> &suppressed = *param->suppressed_stacks;
+  for (uptr i = 0; i < n; i++) {
+    uptr chunk = GetUserBegin(chunks[i]);
+    LsanMetadata m(chunk);
+    if (!m.allocated())
+      continue;
+    ChunkTag tag = m.tag();
+    if (param->reset_tags && tag != kIgnored && tag != kDirectlyLeaked) {
+      tag = kDirectlyLeaked;
+      m.set_tag(tag);
+    }
+    if (tag != kIgnored && !suppressed.empty()) {
+      uptr idx = InternalLowerBound(suppressed, m.stack_trace_id());
+      if (idx < suppressed.size() && m.stack_trace_id() == suppressed[idx]) {
+        LOG_POINTERS("Suppressed: chunk %p-%p of size %zu.\n", (void *)chunk,
+                     (void *)(chunk + m.requested_size()), m.requested_size());
+        tag = kIgnored;
+        m.set_tag(tag);
+      }
+    }
+    if (tag == kIgnored) {
+      LOG_POINTERS("Ignored: chunk %p-%p of size %zu.\n", (void *)chunk,
+                   (void *)(chunk + m.requested_size()), m.requested_size());
+      param->frontier->push_back(chunk);
+    }
+    param->heap_begin = Min(param->heap_begin, chunk);
+    // The end is inclusive for the operator new[] cookie special case.
+    param->heap_end = Max(param->heap_end, chunk + m.requested_size() + 1);
+  }
+}
+
+// Prepares chunks for classification, and restricts pointer candidates in
+// ScanRangeForPointers() to the range covered by allocated chunks.
+static void PrepareChunks(Frontier *frontier, bool reset_tags) {
+  PrepareChunksParam param = {
+      frontier, &GetSuppressionContext()->GetSortedSuppressedStacks(),
+      reset_tags, ~(uptr)0, 0};
+  ForEachChunkBatch(PrepareChunksCb, &param);
+  if (param.heap_begin >= param.heap_end) {
+    // No chunks, so nothing can be a pointer into one.
+    param.heap_begin = param.heap_end = 0;
+  }
+  heap_range.begin = param.heap_begin;
+  heap_range.end = param.heap_end;
+  LOG_POINTERS("Heap range: %p-%p.\n", (void *)param.heap_begin,
+               (void *)param.heap_end);
 }
 
-// ForEachChunk callback. If chunk is marked as ignored, adds its address to
-// frontier.
-static void CollectIgnoredCb(uptr chunk, void *arg) {
+// ForEachChunkBatch callback. If a chunk was reachable in the previous leak
+// check, scans the pages of it that were written since.
+static void ScanDirtyReachableCb(const uptr *chunks, uptr n, void *arg) {
   CHECK(arg);
-  chunk = GetUserBegin(chunk);
-  LsanMetadata m(chunk);
-  if (m.allocated() && m.tag() == kIgnored) {
-    LOG_POINTERS("Ignored: chunk %p-%p of size %zu.\n", (void *)chunk,
-                 (void *)(chunk + m.requested_size()), m.requested_size());
-    reinterpret_cast<Frontier *>(arg)->push_back(chunk);
+  for (uptr i = 0; i < n; i++) {
+    uptr chunk = GetUserBegin(chunks[i]);
+    LsanMetadata m(chunk);
+    if (m.allocated() && m.tag() == kReachable)
+      ScanDirtyRangeForPointers(chunk, chunk + m.requested_size(),
+                                reinterpret_cast<Frontier *>(arg), "HEAP");
   }
 }
 
 // Sets the appropriate tag on each chunk.
 static void ClassifyAllChunks(SuspendedThreadsList const &suspended_threads,
-                              Frontier *frontier) {
-  const InternalMmapVector<u32> &suppressed_stacks =
-      GetSuppressionContext()->GetSortedSuppressedStacks();
-  if (!suppressed_stacks.empty()) {
-    ForEachChunk(IgnoredSuppressedCb,
-                 const_cast<InternalMmapVector<u32> *>(&suppressed_stacks));
-  }
-  ForEachChunk(CollectIgnoredCb, frontier);
+                              Frontier *frontier, uptr mark_threads,
+                              bool reset_tags, bool incremental) {
+  PrepareChunks(frontier, reset_tags);
+  // Chunks that were reachable in the previous check keep their tags. Any
+  // pointer to a chunk that was not must have been written since.
+  scan_dirty_only = incremental;
   ProcessGlobalRegions(frontier);
   ProcessThreads(suspended_threads, frontier);
   ProcessRootRegions(frontier);
-  FloodFillTag(frontier, kReachable);
+  if (incremental) {
+    LOG_POINTERS("Scanning written pages of reachable chunks.\n");
+    ForEachChunkBatch(ScanDirtyReachableCb, frontier);
+  }
+  scan_dirty_only = false;
+  FloodFillTag(frontier, kReachable, mark_threads);
 
   // The check here is relatively expensive, so we do this in a separate flood
   // fill. That way we can skip the check for chunks that are reachable
   // otherwise.
   LOG_POINTERS("Processing platform-specific allocations.\n");
   ProcessPlatformSpecificAllocations(frontier);
-  FloodFillTag(frontier, kReachable);
+  FloodFillTag(frontier, kReachable, mark_threads);
 
   // Iterate over leaked chunks and mark those that are reachable from other
   // leaked chunks.
   LOG_POINTERS("Scanning leaked chunks.\n");
-  ForEachChunk(MarkIndirectlyLeakedCb, nullptr);
+  ForEachChunkBatch(MarkIndirectlyLeakedCb, nullptr);
+  heap_range.begin = 0;
+  heap_range.end = ~(uptr)0;
 }
 
 // ForEachChunk callback. Resets the tags to pre-leak-check state.
@@ -607,17 +832,32 @@ static void ResetTagsCb(uptr chunk, void *arg) {
     m.set_tag(kDirectlyLeaked);
 }
 
-// ForEachChunk callback. Aggregates information about unreachable chunks into
-// a LeakReport.
-static void CollectLeaksCb(uptr chunk, void *arg) {
+struct CollectLeaksParam {
+  LeakedChunks *leaks;
+  bool keep_reachable;
+};
+
+// ForEachChunkBatch callback. Aggregates information about unreachable chunks
+// into a LeakReport, and resets the tags to pre-leak-check state. If
+// |keep_reachable|, reachable chunks keep their tags for the next incremental
+// check. This assumes we did not overwrite any kIgnored tags.
+static void CollectLeaksCb(const uptr *chunks, uptr n, void *arg) {
   CHECK(arg);
-  LeakedChunks *leaks = reinterpret_cast<LeakedChunks *>(arg);
-  chunk = GetUserBegin(chunk);
-  LsanMetadata m(chunk);
-  if (!m.allocated())
-    return;
-  if (m.tag() == kDirectlyLeaked || m.tag() == kIndirectlyLeaked)
-    leaks->push_back({chunk, m.stack_trace_id(), m.requested_size(), m.tag()});
+  CollectLeaksParam *param = reinterpret_cast<CollectLeaksParam *>(arg);
+  for (uptr i = 0; i < n; i++) {
+    uptr chunk = GetUserBegin(chunks[i]);
+    LsanMetadata m(chunk);
+    if (!m.allocated())
+      continue;
+    ChunkTag tag = m.tag();
+    if (tag == kDirectlyLeaked || tag == kIndirectlyLeaked) {
+      param->leaks->push_back(
+          {chunk, m.stack_trace_id(), m.requested_size(), tag});
+    }
+    if (tag == kIndirectlyLeaked ||
+        (tag == kReachable && !param->keep_reachable))
+      m.set_tag(kDirectlyLeaked);
+  }
 }
 
 void LeakSuppressionContext::PrintMatchedSuppressions() {
@@ -671,23 +911,38 @@ static void ReportUnsuspendedThreads(
 
 #  endif  // !SANITIZER_FUCHSIA
 
+// Whether the tags of reachable chunks were kept by the previous check.
+static bool marks_kept = false;
+
 static void CheckForLeaksCallback(const SuspendedThreadsList &suspended_threads,
                                   void *arg) {
   CheckForLeaksParam *param = reinterpret_cast<CheckForLeaksParam *>(arg);
   CHECK(param);
   CHECK(!param->success);
   ReportUnsuspendedThreads(suspended_threads);
-  ClassifyAllChunks(suspended_threads, &param->frontier);
-  ForEachChunk(CollectLeaksCb, &param->leaks);
-  // Clean up for subsequent leak checks. This assumes we did not overwrite any
-  // kIgnored tags.
-  ForEachChunk(ResetTagsCb, nullptr);
+  // A previous periodic check may have left reachable chunks tagged.
+  ClassifyAllChunks(suspended_threads, &param->frontier, param->mark_threads,
+                    /* reset_tags */ marks_kept && !param->incremental,
+                    param->incremental);
+  CollectLeaksParam collect_param = {&param->leaks, param->keep_marks};
+  ForEachChunkBatch(CollectLeaksCb, &collect_param);
+  // Nothing runs between clearing the soft-dirty bits and resuming threads,
+  // so any pointer written after this check is seen by the next one.
+  marks_kept = param->keep_marks && ClearSoftDirtyPages();
+  if (param->keep_marks && !marks_kept)
+    ForEachChunk(ResetTagsCb, nullptr);
   param->success = true;
 }
 
-static bool PrintResults(LeakReport &report) {
-  uptr unsuppressed_count = report.UnsuppressedLeakCount();
-  if (unsuppressed_count) {
+// Leak sites found by the previous recoverable leak check.
+static LeakLedger leak_ledger;
+
+static bool PrintResults(LeakReport &report, bool recoverable) {
+  bool use_ledger = recoverable && (flags()->report_new_leaks_only ||
+                                    flags()->print_leak_deltas);
+  if (use_ledger)
+    report.UpdateLedger(&leak_ledger, flags()->report_new_leaks_only);
+  if (report.ReportableLeakCount()) {
     Decorator d;
     Printf(
         "\n"
@@ -700,14 +955,27 @@ static bool PrintResults(LeakReport &report) {
   }
   if (common_flags()->print_suppressions)
     GetSuppressionContext()->PrintMatchedSuppressions();
-  if (unsuppressed_count > 0) {
+  if (use_ledger && flags()->print_leak_deltas)
+    report.PrintLeakDeltas();
+  // With report_new_leaks_only, leaks that did not grow are neither
+  // reported nor counted in the summary.
+  if (report.ReportableLeakCount()) {
     report.PrintSummary();
     return true;
   }
   return false;
 }
 
-static bool CheckForLeaks() {
+// Computed before stopping the world, which is where the threads are used.
+static uptr GetMarkThreads() {
+  const uptr kMaxMarkThreads = 64;
+  uptr n = flags()->mark_threads > 0 ? flags()->mark_threads
+                                     : GetNumberOfCPUsCached();
+  return Max((uptr)1, Min(n, kMaxMarkThreads));
+}
+
+static bool CheckForLeaks(bool recoverable, bool keep_marks = false,
+                          bool incremental = false) {
   if (&__lsan_is_turned_off && __lsan_is_turned_off())
     return false;
   // Inside LockStuffAndStopTheWorld we can't run symbolizer, so we can't match
@@ -716,6 +984,9 @@ static bool CheckForLeaks() {
   for (int i = 0;; ++i) {
     EnsureMainThreadIDIsCorrect();
     CheckForLeaksParam param;
+    param.mark_threads = GetMarkThreads();
+    param.keep_marks = keep_marks;
+    param.incremental = incremental && marks_kept;
     LockStuffAndStopTheWorld(CheckForLeaksCallback, &param);
     if (!param.success) {
       Report("LeakSanitizer has encountered a fatal error.\n");
@@ -731,16 +1002,16 @@ static bool CheckForLeaks() {
     leak_report.AddLeakedChunks(param.leaks);
 
     // No new suppressions stacks, so rerun will not help and we can report.
-    if (!leak_report.ApplySuppressions())
-      return PrintResults(leak_report);
+    if (!leak_report.ApplySuppressions(leak_ledger))
+      return PrintResults(leak_report, recoverable);
 
     // No indirect leaks to report, so we are done here.
     if (!leak_report.IndirectUnsuppressedLeakCount())
-      return PrintResults(leak_report);
+      return PrintResults(leak_report, recoverable);
 
     if (i >= 8) {
       Report("WARNING: LeakSanitizer gave up on indirect leaks suppression.\n");
-      return PrintResults(leak_report);
+      return PrintResults(leak_report, recoverable);
     }
 
     // We found a new previously unseen suppressed call stack. Rerun to make
@@ -753,25 +1024,61 @@ static bool CheckForLeaks() {
 static bool has_reported_leaks = false;
 bool HasReportedLeaks() { return has_reported_leaks; }
 
+static bool final_leak_check_done = false;
+
 void DoLeakCheck() {
   Lock l(&global_mutex);
-  static bool already_done;
-  if (already_done)
+  if (final_leak_check_done)
     return;
-  already_done = true;
-  has_reported_leaks = CheckForLeaks();
+  final_leak_check_done = true;
+  has_reported_leaks = CheckForLeaks(/* recoverable */ false);
   if (has_reported_leaks)
     HandleLeaks();
 }
 
 static int DoRecoverableLeakCheck() {
   Lock l(&global_mutex);
-  bool have_leaks = CheckForLeaks();
+  bool have_leaks = CheckForLeaks(/* recoverable */ true);
   return have_leaks ? 1 : 0;
 }
 
 void DoRecoverableLeakCheckVoid() { DoRecoverableLeakCheck(); }
 
+static void *PeriodicLeakCheckThread(void *arg) {
+  const uptr interval_ms = flags()->leak_check_interval_ms;
+  const int full_period = Max(flags()->full_leak_check_period, 1);
+  bool incremental = flags()->incremental_leak_check && InitSoftDirtyTracking();
+  VReport(1, "LeakSanitizer: periodic leak checks every %zu ms (%s)\n",
+          interval_ms, incremental ? "incremental" : "full");
+  for (int i = 0;; i++) {
+    SleepForMillis(interval_ms);
+    Lock l(&global_mutex);
+    if (final_leak_check_done)
+      return nullptr;
+    CheckForLeaks(/* recoverable */ true, /* keep_marks */ incremental,
+                  /* incremental */ incremental && i % full_period);
+  }
+}
+
+// A child forked while the periodic thread holds global_mutex would never see
+// it released and would deadlock in DoLeakCheck at exit. Make fork() wait for
+// the running check instead.
+static void LockGlobalMutexForFork() SANITIZER_NO_THREAD_SAFETY_ANALYSIS {
+  global_mutex.Lock();
+}
+
+static void UnlockGlobalMutexForFork() SANITIZER_NO_THREAD_SAFETY_ANALYSIS {
+  global_mutex.Unlock();
+}
+
+void MaybeStartPeriodicLeakChecks() {
+  if (!common_flags()->detect_leaks || flags()->leak_check_interval_ms <= 0)
+    return;
+  InstallAtForkHandler(LockGlobalMutexForFork, UnlockGlobalMutexForFork);
+  if (!internal_start_thread(PeriodicLeakCheckThread, nullptr))
+    Report("WARNING: LeakSanitizer could not start periodic leak checks.\n");
+}
+
 ///// LeakReport implementation. /////
 
 // A hard limit on the number of distinct leaks, to avoid quadratic complexity
@@ -807,9 +1114,15 @@ void LeakReport::AddLeakedChunks(const LeakedChunks &chunks) {
     if (i == leaks_.size()) {
       if (leaks_.size() == kMaxLeaksConsidered)
         return;
-      Leak leak = {next_id_++,         /* hit_count */ 1,
-                   leaked_size,        stack_trace_id,
-                   is_directly_leaked, /* is_suppressed */ false};
+      Leak leak = {next_id_++,
+                   /* hit_count */ 1,
+                   leaked_size,
+                   stack_trace_id,
+                   is_directly_leaked,
+                   /* is_suppressed */ false,
+                   /* hit_count_delta */ 0,
+                   /* total_size_delta */ 0,
+                   /* is_unchanged */ false};
       leaks_.push_back(leak);
     }
     if (flags()->report_objects) {
@@ -835,13 +1148,13 @@ void LeakReport::ReportTopLeaks(uptr num_leaks_to_report) {
         "reported.\n",
         kMaxLeaksConsidered);
 
-  uptr unsuppressed_count = UnsuppressedLeakCount();
+  uptr unsuppressed_count = ReportableLeakCount();
   if (num_leaks_to_report > 0 && num_leaks_to_report < unsuppressed_count)
     Printf("The %zu top leak(s):\n", num_leaks_to_report);
   Sort(leaks_.data(), leaks_.size(), &LeakComparator);
   uptr leaks_reported = 0;
   for (uptr i = 0; i < leaks_.size(); i++) {
-    if (leaks_[i].is_suppressed)
+    if (leaks_[i].is_suppressed || leaks_[i].is_unchanged)
       continue;
     PrintReportForLeak(i);
     leaks_reported++;
@@ -861,6 +1174,12 @@ void LeakReport::PrintReportForLeak(uptr index) {
          leaks_[index].is_directly_leaked ? "Direct" : "Indirect",
          leaks_[index].total_size, leaks_[index].hit_count);
   Printf("%s", d.Default());
+  const Leak &leak = leaks_[index];
+  if (check_ > 1 && leak.total_size_delta > 0 &&
+      leak.total_size_delta != static_cast<sptr>(leak.total_size)) {
+    Printf("Grew by %zd byte(s) in %zd object(s) since the previous check.\n",
+           leak.total_size_delta, leak.hit_count_delta);
+  }
 
   CHECK(leaks_[index].stack_trace_id);
   StackDepotGet(leaks_[index].stack_trace_id).Print();
@@ -885,7 +1204,7 @@ void LeakReport::PrintSummary() {
   CHECK(leaks_.size() <= kMaxLeaksConsidered);
   uptr bytes = 0, allocations = 0;
   for (uptr i = 0; i < leaks_.size(); i++) {
-    if (leaks_[i].is_suppressed)
+    if (leaks_[i].is_suppressed || leaks_[i].is_unchanged)
       continue;
     bytes += leaks_[i].total_size;
     allocations += leaks_[i].hit_count;
@@ -896,10 +1215,28 @@ void LeakReport::PrintSummary() {
   ReportErrorSummary(summary.data());
 }
 
-uptr LeakReport::ApplySuppressions() {
+static u64 LeakLedgerKey(const Leak &leak) {
+  return (static_cast<u64>(leak.stack_trace_id) << 1) |
+         leak.is_directly_leaked;
+}
+
+static bool LeakLedgerKeyLess(const LeakLedgerEntry &entry, u64 key) {
+  return entry.key < key;
+}
+
+static bool LeakLedgerHasKey(const LeakLedger &ledger, u64 key) {
+  uptr idx = InternalLowerBound(ledger.entries, key, LeakLedgerKeyLess);
+  return idx < ledger.entries.size() && ledger.entries[idx].key == key;
+}
+
+uptr LeakReport::ApplySuppressions(const LeakLedger &ledger) {
   LeakSuppressionContext *suppressions = GetSuppressionContext();
   uptr new_suppressions = false;
   for (uptr i = 0; i < leaks_.size(); i++) {
+    // The ledger only records unsuppressed sites, and suppression rules do
+    // not change, so don't symbolize these stacks again.
+    if (LeakLedgerHasKey(ledger, LeakLedgerKey(leaks_[i])))
+      continue;
     if (suppressions->Suppress(leaks_[i].stack_trace_id, leaks_[i].hit_count,
                                leaks_[i].total_size)) {
       leaks_[i].is_suppressed = true;
@@ -917,6 +1254,72 @@ uptr LeakReport::UnsuppressedLeakCount() {
   return result;
 }
 
+void LeakReport::UpdateLedger(LeakLedger *ledger, bool hide_unchanged) {
+  InternalMmapVector<LeakLedgerEntry> entries;
+  entries.reserve(leaks_.size());
+  uptr hit_count = 0, total_size = 0;
+  for (uptr i = 0; i < leaks_.size(); i++) {
+    Leak &leak = leaks_[i];
+    if (leak.is_suppressed)
+      continue;
+    u64 key = LeakLedgerKey(leak);
+    uptr prev_hit_count = 0, prev_total_size = 0;
+    uptr idx = InternalLowerBound(ledger->entries, key, LeakLedgerKeyLess);
+    if (idx < ledger->entries.size() && ledger->entries[idx].key == key) {
+      prev_hit_count = ledger->entries[idx].hit_count;
+      prev_total_size = ledger->entries[idx].total_size;
+    }
+    leak.hit_count_delta = leak.hit_count - prev_hit_count;
+    leak.total_size_delta = leak.total_size - prev_total_size;
+    leak.is_unchanged = hide_unchanged && prev_hit_count &&
+                        leak.hit_count_delta <= 0 && leak.total_size_delta <= 0;
+    entries.push_back({key, leak.hit_count, leak.total_size});
+    hit_count += leak.hit_count;
+    total_size += leak.total_size;
+  }
+  Sort(entries.data(), entries.size(),
+       [](const LeakLedgerEntry &a, const LeakLedgerEntry &b) {
+         return a.key < b.key;
+       });
+  check_ = ++ledger->checks;
+  hit_count_delta_ = hit_count - ledger->hit_count;
+  total_size_delta_ = total_size - ledger->total_size;
+  ledger->entries.swap(entries);
+  ledger->hit_count = hit_count;
+  ledger->total_size = total_size;
+}
+
+uptr LeakReport::ReportableLeakCount() {
+  uptr result = 0;
+  for (uptr i = 0; i < leaks_.size(); i++)
+    if (!leaks_[i].is_suppressed && !leaks_[i].is_unchanged)
+      result++;
+  return result;
+}
+
+void LeakReport::PrintLeakDeltas() {
+  uptr hit_count = 0, total_size = 0;
+  for (uptr i = 0; i < leaks_.size(); i++) {
+    const Leak &leak = leaks_[i];
+    if (leak.is_suppressed)
+      continue;
+    hit_count += leak.hit_count;
+    total_size += leak.total_size;
+    if (!leak.hit_count_delta && !leak.total_size_delta)
+      continue;
+    Printf(
+        "LEAK_DELTA check=%u stack_id=%u kind=%s objects=%zu bytes=%zu "
+        "delta_objects=%zd delta_bytes=%zd\n",
+        check_, leak.stack_trace_id,
+        leak.is_directly_leaked ? "direct" : "indirect", leak.hit_count,
+        leak.total_size, leak.hit_count_delta, leak.total_size_delta);
+  }
+  Printf(
+      "LEAK_TOTAL check=%u objects=%zu bytes=%zu delta_objects=%zd "
+      "delta_bytes=%zd\n",
+      check_, hit_count, total_size, hit_count_delta_, total_size_delta_);
+}
+
 uptr LeakReport::IndirectUnsuppressedLeakCount() {
   uptr result = 0;
   for (uptr i = 0; i < leaks_.size(); i++)
@@ -931,6 +1334,7 @@ namespace __lsan {
 void InitCommonLsan() {}
 void DoLeakCheck() {}
 void DoRecoverableLeakCheckVoid() {}
+void MaybeStartPeriodicLeakChecks() {}
 void DisableInThisThread() {}
 void EnableInThisThread() {}
 }  // namespace __lsan
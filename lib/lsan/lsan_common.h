@@ -98,6 +98,26 @@ struct Leak {
   u32 stack_trace_id;
   bool is_directly_leaked;
   bool is_suppressed;
+  // Growth since the previous recoverable leak check, if the leak ledger is
+  // in use.
+  sptr hit_count_delta;
+  sptr total_size_delta;
+  bool is_unchanged;
+};
+
+// An unsuppressed leak site recorded by a recoverable leak check.
+struct LeakLedgerEntry {
+  u64 key;
+  uptr hit_count;
+  uptr total_size;
+};
+
+// Leaks found by the previous recoverable leak check.
+struct LeakLedger {
+  InternalMmapVectorNoCtor<LeakLedgerEntry> entries;  // Sorted by key.
+  uptr hit_count;
+  uptr total_size;
+  u32 checks;
 };
 
 struct LeakedObject {
@@ -113,15 +133,26 @@ class LeakReport {
   void AddLeakedChunks(const LeakedChunks &chunks);
   void ReportTopLeaks(uptr max_leaks);
   void PrintSummary();
-  uptr ApplySuppressions();
+  // Sites found in |ledger| are known not to be suppressed and are skipped.
+  uptr ApplySuppressions(const LeakLedger &ledger);
   uptr UnsuppressedLeakCount();
   uptr IndirectUnsuppressedLeakCount();
+  // Computes how much each leak grew since the check recorded in |ledger|,
+  // then records this check in it. If |hide_unchanged|, leaks that did not
+  // grow are left out of ReportTopLeaks() and PrintSummary().
+  void UpdateLedger(LeakLedger *ledger, bool hide_unchanged);
+  uptr ReportableLeakCount();
+  // Prints the growth computed by UpdateLedger() in a machine-readable form.
+  void PrintLeakDeltas();
 
  private:
   void PrintReportForLeak(uptr index);
   void PrintLeakedObjectsForLeak(uptr index);
 
   u32 next_id_ = 0;
+  u32 check_ = 0;
+  sptr hit_count_delta_ = 0;
+  sptr total_size_delta_ = 0;
   InternalMmapVector<Leak> leaks_;
   InternalMmapVector<LeakedObject> leaked_objects_;
 };
@@ -132,6 +163,19 @@ typedef InternalMmapVector<uptr> Frontier;
 void InitializePlatformSpecificModules();
 void ProcessGlobalRegions(Frontier *frontier);
 void ProcessPlatformSpecificAllocations(Frontier *frontier);
+// Runs |fn(arg)| on the calling thread and on up to |n - 1| helper threads
+// that share the address space, and waits for all of them to finish. Called
+// while the world is stopped.
+void RunMarkWorkers(uptr n, void (*fn)(void *arg), void *arg);
+// Soft-dirty page tracking, used by incremental leak checks. Init returns
+// false if it is not supported. Clear and IsSoftDirtyPage are called while
+// the world is stopped.
+bool InitSoftDirtyTracking();
+bool ClearSoftDirtyPages();
+bool IsSoftDirtyPage(uptr addr);
+// Registers |before| to run in the parent before fork() and |after| to run in
+// both processes after it. Does nothing on platforms without fork().
+void InstallAtForkHandler(void (*before)(), void (*after)());
 
 struct RootRegion {
   uptr begin;
@@ -145,6 +189,13 @@ struct RootRegion {
 struct CheckForLeaksParam {
   Frontier frontier;
   LeakedChunks leaks;
+  uptr mark_threads = 1;
+  // Leave the tags of reachable chunks in place for the next check, and start
+  // tracking the pages written after this one.
+  bool keep_marks = false;
+  // Only rescan the written pages of chunks kept reachable by the previous
+  // check, and of global and root regions.
+  bool incremental = false;
   bool success = false;
 };
 
@@ -174,6 +225,8 @@ const char *MaybeCallLsanDefaultOptions();
 void InitCommonLsan();
 void DoLeakCheck();
 void DoRecoverableLeakCheckVoid();
+// Must be called once the parent tool can start threads.
+void MaybeStartPeriodicLeakChecks();
 void DisableCounterUnderflow();
 bool DisabledInThisThread();
 
@@ -222,6 +275,7 @@ inline bool IsSpecialCaseOfOperatorNew0(uptr chunk_beg, uptr chunk_size,
 // The following must be implemented in the parent tool.
 
 void ForEachChunk(ForEachChunkCallback callback, void *arg);
+void ForEachChunkBatch(ForEachChunkBatchCallback callback, void *arg);
 // Returns the address range occupied by the global allocator object.
 void GetAllocatorGlobalRange(uptr *begin, uptr *end);
 // Wrappers for allocator's ForceLock()/ForceUnlock().
@@ -287,6 +341,9 @@ class LsanMetadata {
   bool allocated() const;
   ChunkTag tag() const;
   void set_tag(ChunkTag value);
+  // Atomically sets the tag to |xchg| if it is |cmp|. Returns false if the
+  // tag was different, e.g. because another marker thread got there first.
+  bool compare_exchange_tag(ChunkTag cmp, ChunkTag xchg);
   uptr requested_size() const;
   u32 stack_trace_id() const;
  private:
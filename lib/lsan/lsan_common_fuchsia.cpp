@@ -52,6 +52,14 @@ void ProcessPlatformSpecificAllocations(Frontier *frontier) {}
 // behavior and causes rare race conditions.
 void HandleLeaks() {}
 
+void RunMarkWorkers(uptr n, void (*fn)(void *arg), void *arg) { fn(arg); }
+
+bool InitSoftDirtyTracking() { return false; }
+bool ClearSoftDirtyPages() { return false; }
+bool IsSoftDirtyPage(uptr addr) { return true; }
+
+void InstallAtForkHandler(void (*before)(), void (*after)()) {}
+
 // This is defined differently in asan_fuchsia.cpp and lsan_fuchsia.cpp.
 bool UseExitcodeOnLeak();
 
@@ -17,11 +17,19 @@
 
 #if CAN_SANITIZE_LEAKS && (SANITIZER_LINUX || SANITIZER_NETBSD)
 #include <link.h>
+#include <pthread.h>
+#if SANITIZER_LINUX
+#include <errno.h>
+#include <sched.h>     // for CLONE_* definitions
+#include <sys/wait.h>  // for __WALL
+#endif
 
 #include "sanitizer_common/sanitizer_common.h"
+#include "sanitizer_common/sanitizer_file.h"
 #include "sanitizer_common/sanitizer_flags.h"
 #include "sanitizer_common/sanitizer_getauxval.h"
 #include "sanitizer_common/sanitizer_linux.h"
+#include "sanitizer_common/sanitizer_posix.h"
 #include "sanitizer_common/sanitizer_stackdepot.h"
 
 namespace __lsan {
@@ -108,6 +116,135 @@ LoadedModule *GetLinker() { return linker; }
 
 void ProcessPlatformSpecificAllocations(Frontier *frontier) {}
 
+#if SANITIZER_LINUX
+static const uptr kMarkWorkerStackSize = 256 << 10;
+
+struct MarkWorkerArg {
+  void (*fn)(void *arg);
+  void *arg;
+};
+
+static int MarkWorkerThread(void *argument) {
+  MarkWorkerArg *arg = reinterpret_cast<MarkWorkerArg *>(argument);
+  arg->fn(arg->arg);
+  return 0;
+}
+
+// Called from the tracer task, so helpers are spawned the same way the tracer
+// itself is: as raw clones that share the address space but have no TLS of
+// their own. The helpers do not use errno, so sharing it is harmless.
+void RunMarkWorkers(uptr n, void (*fn)(void *arg), void *arg) {
+  const uptr kMaxHelpers = 64;
+  MarkWorkerArg worker_arg = {fn, arg};
+  uptr guard_size = GetPageSizeCached();
+  uptr stack_size = kMarkWorkerStackSize + guard_size;
+  uptr pids[kMaxHelpers];
+  uptr stacks[kMaxHelpers];
+  uptr helpers = 0;
+  for (; helpers < Min(n - 1, kMaxHelpers); helpers++) {
+    uptr stack = (uptr)MmapOrDie(stack_size, "LSan mark worker stack");
+    CHECK(MprotectNoAccess(stack, guard_size));
+    int local_errno = 0;
+    uptr pid = internal_clone(MarkWorkerThread, (void *)(stack + stack_size),
+                              CLONE_VM | CLONE_FS | CLONE_FILES | CLONE_UNTRACED,
+                              &worker_arg, nullptr /* parent_tidptr */,
+                              nullptr /* newtls */, nullptr /* child_tidptr */);
+    if (internal_iserror(pid, &local_errno)) {
+      VReport(1, "Failed spawning a mark worker (errno %d).\n", local_errno);
+      UnmapOrDie((void *)stack, stack_size);
+      break;
+    }
+    pids[helpers] = pid;
+    stacks[helpers] = stack;
+  }
+  fn(arg);
+  for (uptr i = 0; i < helpers; i++) {
+    for (;;) {
+      int local_errno = 0;
+      uptr waitpid_status = internal_waitpid(pids[i], nullptr, __WALL);
+      if (!internal_iserror(waitpid_status, &local_errno))
+        break;
+      if (local_errno == EINTR)
+        continue;
+      Report("Waiting on a mark worker failed (errno %d).\n", local_errno);
+      Die();
+    }
+    UnmapOrDie((void *)stacks[i], stack_size);
+  }
+}
+
+// See Documentation/admin-guide/mm/soft-dirty.rst in the kernel tree.
+static const u64 kPagemapSoftDirty = 1ULL << 55;
+static const uptr kPagemapCacheEntries = 512;
+
+static fd_t pagemap_fd = kInvalidFd;
+static uptr pagemap_cache_first_page;
+static bool pagemap_cache_valid;
+static u64 pagemap_cache[kPagemapCacheEntries];
+
+bool ClearSoftDirtyPages() {
+  pagemap_cache_valid = false;
+  fd_t fd = OpenFile("/proc/self/clear_refs", WrOnly);
+  if (fd == kInvalidFd)
+    return false;
+  bool res = WriteToFile(fd, "4", 1);
+  CloseFile(fd);
+  return res;
+}
+
+bool IsSoftDirtyPage(uptr addr) {
+  uptr page = addr / GetPageSizeCached();
+  if (!pagemap_cache_valid ||
+      page - pagemap_cache_first_page >= kPagemapCacheEntries) {
+    pagemap_cache_first_page = RoundDownTo(page, kPagemapCacheEntries);
+    pagemap_cache_valid = true;
+    uptr read = 0;
+    OFF_T offset = pagemap_cache_first_page * sizeof(u64);
+    if (internal_lseek(pagemap_fd, offset, SEEK_SET) != (uptr)offset ||
+        !ReadFromFile(pagemap_fd, pagemap_cache, sizeof(pagemap_cache),
+                      &read))
+      read = 0;
+    // Treat pages we could not look up as written.
+    for (uptr i = read / sizeof(u64); i < kPagemapCacheEntries; i++)
+      pagemap_cache[i] = kPagemapSoftDirty;
+  }
+  return pagemap_cache[page - pagemap_cache_first_page] & kPagemapSoftDirty;
+}
+
+// The soft-dirty bit is always clear on kernels built without
+// CONFIG_MEM_SOFT_DIRTY, so check that writes actually set it.
+bool InitSoftDirtyTracking() {
+  if (pagemap_fd == kInvalidFd)
+    pagemap_fd = OpenFile("/proc/self/pagemap", RdOnly);
+  if (pagemap_fd == kInvalidFd)
+    return false;
+  uptr page_size = GetPageSizeCached();
+  volatile char *page = (volatile char *)MmapOrDie(page_size, "LSan pagemap");
+  page[0] = 1;
+  bool res = ClearSoftDirtyPages() && !IsSoftDirtyPage((uptr)page);
+  page[0] = 2;
+  pagemap_cache_valid = false;
+  res = res && IsSoftDirtyPage((uptr)page);
+  pagemap_cache_valid = false;
+  UnmapOrDie((void *)page, page_size);
+  if (!res) {
+    CloseFile(pagemap_fd);
+    pagemap_fd = kInvalidFd;
+  }
+  return res;
+}
+#else
+void RunMarkWorkers(uptr n, void (*fn)(void *arg), void *arg) { fn(arg); }
+
+bool InitSoftDirtyTracking() { return false; }
+bool ClearSoftDirtyPages() { return false; }
+bool IsSoftDirtyPage(uptr addr) { return true; }
+#endif
+
+void InstallAtForkHandler(void (*before)(), void (*after)()) {
+  pthread_atfork(before, after, after);
+}
+
 struct DoStopTheWorldParam {
   StopTheWorldCallback callback;
   void *argument;
@@ -193,6 +193,16 @@ void ProcessPlatformSpecificAllocations(Frontier *frontier) {
 // causes rare race conditions.
 void HandleLeaks() {}
 
+void RunMarkWorkers(uptr n, void (*fn)(void *arg), void *arg) { fn(arg); }
+
+bool InitSoftDirtyTracking() { return false; }
+bool ClearSoftDirtyPages() { return false; }
+bool IsSoftDirtyPage(uptr addr) { return true; }
+
+void InstallAtForkHandler(void (*before)(), void (*after)()) {
+  pthread_atfork(before, after, after);
+}
+
 void LockStuffAndStopTheWorld(StopTheWorldCallback callback,
                               CheckForLeaksParam *argument) {
   ScopedStopTheWorldLock lock;
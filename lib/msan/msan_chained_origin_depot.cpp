@@ -13,17 +13,32 @@
 
 #include "msan_chained_origin_depot.h"
 
+#include "msan.h"
 #include "sanitizer_common/sanitizer_chained_origin_depot.h"
 
 namespace __msan {
 
 static ChainedOriginDepot chainedOriginDepot;
 
+// Chained origin ids have 28 bits (see msan_origin.h) and the depot
+// CHECK-fails when it runs out of them. Leave some slack for
+// concurrent inserts that passed the size check.
+static const u32 kMaxChains = (1u << 28) - (1u << 16);
+
+static u32 MaxChains() {
+  int limit = flags()->origin_history_max_chains;
+  return limit > 0 ? Min<u32>(limit, kMaxChains) : kMaxChains;
+}
+
 StackDepotStats ChainedOriginDepotGetStats() {
   return chainedOriginDepot.GetStats();
 }
 
 bool ChainedOriginDepotPut(u32 here_id, u32 prev_id, u32 *new_id) {
+  if (UNLIKELY(chainedOriginDepot.Size() >= MaxChains())) {
+    *new_id = chainedOriginDepot.Find(here_id, prev_id);
+    return false;
+  }
   return chainedOriginDepot.Put(here_id, prev_id, new_id);
 }
 
@@ -25,6 +25,8 @@ StackDepotStats ChainedOriginDepotGetStats();
 // If successful, returns true and the new chain id new_id.
 // If the same element already exists, returns false and sets new_id to the
 // existing ID.
+// If the depot is full (see origin_history_max_chains), only existing
+// elements are found, otherwise returns false and sets new_id to 0.
 bool ChainedOriginDepotPut(u32 here_id, u32 prev_id, u32 *new_id);
 
 // Retrieves the stored StackDepot ID for the given origin ID.
@@ -129,6 +129,8 @@ class Origin {
 
     u32 chained_id;
     bool inserted = ChainedOriginDepotPut(h.id(), prev.raw_id(), &chained_id);
+    // The depot is full.
+    if (!chained_id) return prev;
     CHECK((chained_id & kChainedIdMask) == chained_id);
 
     if (inserted && flags()->origin_history_per_stack_limit > 0)
@@ -40,6 +40,80 @@ void SetOriginIfPoisoned(uptr addr, uptr src_shadow, uptr size,
     if (*(u8 *)src_s) *(u32 *)SHADOW_TO_ORIGIN(dst_s & ~3UL) = src_origin;
 }
 
+// Origins of 4-byte aligned ranges are copied in blocks of kOriginCopyBlock
+// bytes of application memory. Blocks with fully initialized source shadow
+// are skipped, so copying initialized memory only reads the source shadow.
+static const uptr kOriginCopyBlock = 64;
+
+// Returns true if any of n shadow granules starting at s is poisoned.
+// Written to be vectorized by the compiler.
+static inline bool IsShadowPoisoned(const u32 *s, uptr n) {
+  u32 acc = 0;
+  for (uptr i = 0; i < n; ++i) acc |= s[i];
+  return acc;
+}
+
+// Copies origins of poisoned granules of [src, src + size) to
+// [dst, dst + size). All arguments are multiples of 4.
+static void CopyOriginAligned(uptr dst, uptr src, uptr size,
+                              StackTrace *stack) {
+  const u32 *src_s = (const u32 *)MEM_TO_SHADOW(src);
+  const u32 *src_o = (const u32 *)MEM_TO_ORIGIN(src);
+  u32 *dst_o = (u32 *)MEM_TO_ORIGIN(dst);
+  const uptr n = size / 4;
+  const uptr kBlock = kOriginCopyBlock / 4;
+  const bool chain = __msan_get_track_origins() > 1;
+  u32 prev_src_o = 0;
+  u32 prev_dst_o = 0;
+  for (uptr i = 0; i < n; i += kBlock) {
+    uptr block = Min(kBlock, n - i);
+    if (!IsShadowPoisoned(src_s + i, block)) continue;
+    for (uptr j = i; j < i + block; ++j) {
+      if (!src_s[j]) continue;
+      u32 o = src_o[j];
+      if (chain) {
+        if (o != prev_src_o) {
+          prev_src_o = o;
+          prev_dst_o = ChainOrigin(o, stack);
+        }
+        o = prev_dst_o;
+      }
+      dst_o[j] = o;
+    }
+  }
+}
+
+// Same as CopyOriginAligned, but walks the range backwards, so it is safe
+// for overlapping ranges with dst > src.
+static void ReverseCopyOriginAligned(uptr dst, uptr src, uptr size,
+                                     StackTrace *stack) {
+  const u32 *src_s = (const u32 *)MEM_TO_SHADOW(src);
+  const u32 *src_o = (const u32 *)MEM_TO_ORIGIN(src);
+  u32 *dst_o = (u32 *)MEM_TO_ORIGIN(dst);
+  const uptr kBlock = kOriginCopyBlock / 4;
+  const bool chain = __msan_get_track_origins() > 1;
+  u32 prev_src_o = 0;
+  u32 prev_dst_o = 0;
+  for (uptr i = size / 4; i > 0;) {
+    uptr block = Min(kBlock, i);
+    i -= block;
+    if (!IsShadowPoisoned(src_s + i, block)) continue;
+    for (uptr j = i + block; j > i;) {
+      --j;
+      if (!src_s[j]) continue;
+      u32 o = src_o[j];
+      if (chain) {
+        if (o != prev_src_o) {
+          prev_src_o = o;
+          prev_dst_o = ChainOrigin(o, stack);
+        }
+        o = prev_dst_o;
+      }
+      dst_o[j] = o;
+    }
+  }
+}
+
 void CopyOrigin(const void *dst, const void *src, uptr size,
                 StackTrace *stack) {
   if (!MEM_IS_APP(dst) || !MEM_IS_APP(src)) return;
@@ -72,26 +146,7 @@ void CopyOrigin(const void *dst, const void *src, uptr size,
   if (beg < end) {
     // Align src up.
     uptr s = ((uptr)src + 3) & ~3UL;
-    // FIXME: factor out to msan_copy_origin_aligned
-    if (__msan_get_track_origins() > 1) {
-      u32 *src = (u32 *)MEM_TO_ORIGIN(s);
-      u32 *src_s = (u32 *)MEM_TO_SHADOW(s);
-      u32 *src_end = (u32 *)MEM_TO_ORIGIN(s + (end - beg));
-      u32 *dst = (u32 *)MEM_TO_ORIGIN(beg);
-      u32 src_o = 0;
-      u32 dst_o = 0;
-      for (; src < src_end; ++src, ++src_s, ++dst) {
-        if (!*src_s) continue;
-        if (*src != src_o) {
-          src_o = *src;
-          dst_o = ChainOrigin(src_o, stack);
-        }
-        *dst = dst_o;
-      }
-    } else {
-      REAL(memcpy)((void *)MEM_TO_ORIGIN(beg), (void *)MEM_TO_ORIGIN(s),
-                   end - beg);
-    }
+    CopyOriginAligned(beg, s, end - beg, stack);
   }
 }
 
@@ -115,29 +170,10 @@ void ReverseCopyOrigin(const void *dst, const void *src, uptr size,
 
   uptr beg = d & ~3UL;
 
-  if (beg + 4 < end) {
+  if (beg < end) {
     // Align src up.
     uptr s = ((uptr)src + 3) & ~3UL;
-    if (__msan_get_track_origins() > 1) {
-      u32 *src = (u32 *)MEM_TO_ORIGIN(s + end - beg - 4);
-      u32 *src_s = (u32 *)MEM_TO_SHADOW(s + end - beg - 4);
-      u32 *src_begin = (u32 *)MEM_TO_ORIGIN(s);
-      u32 *dst = (u32 *)MEM_TO_ORIGIN(end - 4);
-      u32 src_o = 0;
-      u32 dst_o = 0;
-      for (; src >= src_begin; --src, --src_s, --dst) {
-        if (!*src_s)
-          continue;
-        if (*src != src_o) {
-          src_o = *src;
-          dst_o = ChainOrigin(src_o, stack);
-        }
-        *dst = dst_o;
-      }
-    } else {
-      REAL(memmove)
-      ((void *)MEM_TO_ORIGIN(beg), (void *)MEM_TO_ORIGIN(s), end - beg - 4);
-    }
+    ReverseCopyOriginAligned(beg, s, end - beg, stack);
   }
 
   // Copy left unaligned origin if that memory is poisoned.
@@ -47,6 +47,12 @@ void PrintHintAllocatorCannotReturnNull();
 // Callback type for iterating over chunks.
 typedef void (*ForEachChunkCallback)(uptr chunk, void *arg);
 
+// Callback type for iterating over chunks in batches. All |n| chunks come
+// from the same region, and |n| is at most kForEachChunkBatchSize.
+typedef void (*ForEachChunkBatchCallback)(const uptr *chunks, uptr n,
+                                          void *arg);
+static const uptr kForEachChunkBatchSize = 256;
+
 inline u32 Rand(u32 *state) {  // ANSI C linear congruential PRNG.
   return (*state = *state * 1103515245 + 12345) >> 16;
 }
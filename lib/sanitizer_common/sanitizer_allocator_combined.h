@@ -192,6 +192,11 @@ class CombinedAllocator {
     secondary_.ForEachChunk(callback, arg);
   }
 
+  void ForEachChunkBatch(ForEachChunkBatchCallback callback, void *arg) {
+    primary_.ForEachChunkBatch(callback, arg);
+    secondary_.ForEachChunkBatch(callback, arg);
+  }
+
  private:
   PrimaryAllocator primary_;
   SecondaryAllocator secondary_;
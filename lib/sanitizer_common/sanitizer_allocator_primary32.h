@@ -267,6 +267,30 @@ class SizeClassAllocator32 {
       }
   }
 
+  // Like ForEachChunk(), but passes the chunks of each region to |callback|
+  // in batches.
+  void ForEachChunkBatch(ForEachChunkBatchCallback callback, void *arg) const {
+    uptr batch[kForEachChunkBatchSize];
+    for (vaddr region = 0; region < kNumPossibleRegions; region++)
+      if (possible_regions.contains(region) && possible_regions[region]) {
+        usize chunk_size = ClassIdToSize(possible_regions[region]);
+        usize max_chunks_in_region = kRegionSize / (chunk_size + kMetadataSize);
+        vaddr region_beg = region * kRegionSize;
+        uptr n = 0;
+        for (vaddr chunk = region_beg;
+             chunk < region_beg + max_chunks_in_region * chunk_size;
+             chunk += chunk_size) {
+          batch[n++] = chunk;
+          if (n == kForEachChunkBatchSize) {
+            callback(batch, n, arg);
+            n = 0;
+          }
+        }
+        if (n)
+          callback(batch, n, arg);
+      }
+  }
+
   void PrintStats() {}
 
   static usize AdditionalSize() { return 0; }
@@ -384,6 +384,29 @@ class SizeClassAllocator64 {
     }
   }
 
+  // Like ForEachChunk(), but passes the chunks of each region to |callback|
+  // in batches.
+  void ForEachChunkBatch(ForEachChunkBatchCallback callback, void *arg) {
+    uptr batch[kForEachChunkBatchSize];
+    for (uptr class_id = 1; class_id < kNumClasses; class_id++) {
+      RegionInfo *region = GetRegionInfo(class_id);
+      usize chunk_size = ClassIdToSize(class_id);
+      uptr region_beg = SpaceBeg() + class_id * kRegionSize;
+      uptr region_end =
+          region_beg + AddressSpaceView::Load(region)->allocated_user;
+      uptr n = 0;
+      for (uptr chunk = region_beg; chunk < region_end; chunk += chunk_size) {
+        batch[n++] = chunk;
+        if (n == kForEachChunkBatchSize) {
+          callback(batch, n, arg);
+          n = 0;
+        }
+      }
+      if (n)
+        callback(batch, n, arg);
+    }
+  }
+
   static usize ClassIdToSize(uptr class_id) {
     return SizeClassMap::Size(class_id);
   }
@@ -285,6 +285,24 @@ class LargeMmapAllocator {
     }
   }
 
+  // Like ForEachChunk(), but passes the chunks to |callback| in batches.
+  void ForEachChunkBatch(ForEachChunkBatchCallback callback, void *arg) {
+    EnsureSortedChunks();  // Avoid doing the sort while iterating.
+    const Header *const *chunks = AddressSpaceView::Load(chunks_, n_chunks_);
+    uptr batch[kForEachChunkBatchSize];
+    for (uptr i = 0; i < n_chunks_; i += kForEachChunkBatchSize) {
+      uptr n = Min<uptr>(n_chunks_ - i, kForEachChunkBatchSize);
+      for (uptr j = 0; j < n; j++)
+        batch[j] = reinterpret_cast<uptr>(GetUser(chunks[i + j]));
+      callback(batch, n, arg);
+      // Consistency check: verify that the array did not change.
+      for (uptr j = 0; j < n; j++) {
+        CHECK_EQ(reinterpret_cast<uptr>(GetUser(chunks[i + j])), batch[j]);
+        CHECK_EQ(AddressSpaceView::Load(chunks[i + j])->chunk_idx, i + j);
+      }
+    }
+  }
+
  private:
   struct Header {
     uptr map_beg;
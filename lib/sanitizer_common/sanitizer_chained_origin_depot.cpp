@@ -139,6 +139,13 @@ u32 ChainedOriginDepot::Get(u32 id, u32 *other) {
   return desc.here_id;
 }
 
+u32 ChainedOriginDepot::Find(u32 here_id, u32 prev_id) const {
+  ChainedOriginDepotDesc desc = {here_id, prev_id};
+  return depot.Lookup(desc);
+}
+
+u32 ChainedOriginDepot::Size() const { return depot.Size(); }
+
 void ChainedOriginDepot::LockAll() { depot.LockAll(); }
 
 void ChainedOriginDepot::UnlockAll() { depot.UnlockAll(); }
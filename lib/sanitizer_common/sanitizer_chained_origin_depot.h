@@ -32,6 +32,12 @@ class ChainedOriginDepot {
   // Retrieves the stored StackDepot ID for the given origin ID.
   u32 Get(u32 id, u32 *other);
 
+  // Returns the ID of an existing chain (here_id, prev_id), or 0.
+  u32 Find(u32 here_id, u32 prev_id) const;
+
+  // Returns the number of stored chains.
+  u32 Size() const;
+
   void LockAll();
   void UnlockAll();
   void TestOnlyUnmap();
@@ -60,8 +60,16 @@ class DeadlockDetectorTLS {
     CHECK_EQ(epoch_, current_epoch);
     if (!bv_.setBit(lock_id)) {
       // The lock is already held by this thread, it must be recursive.
+      // Count the recursion depth per lock, so that any depth fits.
+      for (uptr i = 0; i < n_recursive_locks; i++) {
+        if (recursive_locks[i].lock == lock_id) {
+          recursive_locks[i].count++;
+          return false;
+        }
+      }
       CHECK_LT(n_recursive_locks, ARRAY_SIZE(recursive_locks));
-      recursive_locks[n_recursive_locks++] = lock_id;
+      RecursiveLock r = {lock_id, 1};
+      recursive_locks[n_recursive_locks++] = r;
       return false;
     }
     CHECK_LT(n_all_locks_, ARRAY_SIZE(all_locks_with_contexts_));
@@ -75,9 +83,11 @@ class DeadlockDetectorTLS {
   void removeLock(uptr lock_id) {
     if (n_recursive_locks) {
       for (sptr i = n_recursive_locks - 1; i >= 0; i--) {
-        if (recursive_locks[i] == lock_id) {
-          n_recursive_locks--;
-          Swap(recursive_locks[i], recursive_locks[n_recursive_locks]);
+        if (recursive_locks[i].lock == lock_id) {
+          if (--recursive_locks[i].count == 0) {
+            n_recursive_locks--;
+            Swap(recursive_locks[i], recursive_locks[n_recursive_locks]);
+          }
           return;
         }
       }
@@ -114,7 +124,12 @@ class DeadlockDetectorTLS {
  private:
   BV bv_;
   uptr epoch_;
-  uptr recursive_locks[64];
+  // Locks held recursively by this thread and their extra acquisitions.
+  struct RecursiveLock {
+    uptr lock;
+    uptr count;
+  };
+  RecursiveLock recursive_locks[64];
   uptr n_recursive_locks;
   struct LockWithContext {
     u32 lock;
@@ -67,6 +67,10 @@ class StackDepotBase {
   u32 Put(args_type args, bool *inserted = nullptr);
   // Retrieves a stored stack trace by the id.
   args_type Get(u32 id);
+  // Returns the id of a stored stack trace or 0 if it was not stored.
+  u32 Lookup(args_type args) const;
+  // Returns the number of stored stack traces.
+  u32 Size() const { return atomic_load_relaxed(&n_uniq_ids); }
 
   StackDepotStats GetStats() const {
     return {
@@ -111,6 +115,16 @@ u32 StackDepotBase<Node, kReservedBits, kTabSizeLog>::find(
   return 0;
 }
 
+template <class Node, int kReservedBits, int kTabSizeLog>
+u32 StackDepotBase<Node, kReservedBits, kTabSizeLog>::Lookup(
+    args_type args) const {
+  if (!LIKELY(Node::is_valid(args)))
+    return 0;
+  hash_type h = Node::hash(args);
+  u32 v = atomic_load(&tab[h % kTabSize], memory_order_consume);
+  return find(v & kUnlockMask, args, h);
+}
+
 template <class Node, int kReservedBits, int kTabSizeLog>
 u32 StackDepotBase<Node, kReservedBits, kTabSizeLog>::lock(atomic_uint32_t *p) {
   // Uses the pointer lsb as mutex.
@@ -956,6 +956,16 @@ void IterationTestCallback(uptr chunk, void *arg) {
   reinterpret_cast<std::set<uptr> *>(arg)->insert(chunk);
 }
 
+void IterationTestBatchCallback(const uptr *chunks, uptr n, void *arg) {
+  ASSERT_GT(n, 0U);
+  ASSERT_LE(n, kForEachChunkBatchSize);
+  for (uptr i = 0; i < n; i++) {
+    // Check chunk is never reported more than once.
+    auto pair = reinterpret_cast<std::set<uptr> *>(arg)->insert(chunks[i]);
+    ASSERT_TRUE(pair.second);
+  }
+}
+
 template <class Allocator>
 void TestSizeClassAllocatorIteration(uptr premapped_heap = 0) {
   Allocator *a = new Allocator;
@@ -984,8 +994,10 @@ void TestSizeClassAllocatorIteration(uptr premapped_heap = 0) {
   }
 
   std::set<uptr> reported_chunks;
+  std::set<uptr> reported_batched_chunks;
   a->ForceLock();
   a->ForEachChunk(IterationTestCallback, &reported_chunks);
+  a->ForEachChunkBatch(IterationTestBatchCallback, &reported_batched_chunks);
   a->ForceUnlock();
 
   for (uptr i = 0; i < allocated.size(); i++) {
@@ -993,6 +1005,7 @@ void TestSizeClassAllocatorIteration(uptr premapped_heap = 0) {
     ASSERT_NE(reported_chunks.find(reinterpret_cast<uptr>(allocated[i])),
               reported_chunks.end());
   }
+  ASSERT_EQ(reported_chunks, reported_batched_chunks);
 
   a->TestOnlyUnmap();
   delete a;
@@ -1035,8 +1048,10 @@ TEST(SanitizerCommon, LargeMmapAllocatorIteration) {
     allocated[i] = (char *)a.Allocate(&stats, size, 1);
 
   std::set<uptr> reported_chunks;
+  std::set<uptr> reported_batched_chunks;
   a.ForceLock();
   a.ForEachChunk(IterationTestCallback, &reported_chunks);
+  a.ForEachChunkBatch(IterationTestBatchCallback, &reported_batched_chunks);
   a.ForceUnlock();
 
   for (uptr i = 0; i < kNumAllocs; i++) {
@@ -1044,6 +1059,7 @@ TEST(SanitizerCommon, LargeMmapAllocatorIteration) {
     ASSERT_NE(reported_chunks.find(reinterpret_cast<uptr>(allocated[i])),
               reported_chunks.end());
   }
+  ASSERT_EQ(reported_chunks, reported_batched_chunks);
   for (uptr i = 0; i < kNumAllocs; i++)
     a.Deallocate(&stats, allocated[i]);
 }
@@ -13,6 +13,10 @@
 
 #include "sanitizer_common/sanitizer_chained_origin_depot.h"
 
+#include <atomic>
+#include <thread>
+#include <vector>
+
 #include "gtest/gtest.h"
 #include "sanitizer_common/sanitizer_internal_defs.h"
 #include "sanitizer_common/sanitizer_libc.h"
@@ -90,4 +94,49 @@ TEST(SanitizerCommon, ChainedOriginDepotStats) {
   EXPECT_GT(chainedOriginDepot.GetStats().allocated, stats2.allocated);
 }
 
+TEST(SanitizerCommon, ChainedOriginDepotFind) {
+  chainedOriginDepot.TestOnlyUnmap();
+  EXPECT_EQ(0U, chainedOriginDepot.Size());
+  EXPECT_EQ(0U, chainedOriginDepot.Find(41, 42));
+  u32 new_id;
+  EXPECT_TRUE(chainedOriginDepot.Put(41, 42, &new_id));
+  EXPECT_EQ(1U, chainedOriginDepot.Size());
+  EXPECT_EQ(new_id, chainedOriginDepot.Find(41, 42));
+  EXPECT_EQ(0U, chainedOriginDepot.Find(41, 43));
+  EXPECT_EQ(0U, chainedOriginDepot.Find(42, 41));
+  EXPECT_EQ(1U, chainedOriginDepot.Size());
+}
+
+// Stress test for depot insert rate, msan puts a chain on every store
+// of an uninitialized value with -fsanitize-memory-track-origins=2.
+// It's disabled to avoid slowing down check-sanitizer.
+// Usage: Sanitizer-<ARCH>-Test --gtest_also_run_disabled_tests \
+//   '--gtest_filter=*ChainedOriginDepotStress*'
+TEST(SanitizerCommon, DISABLED_ChainedOriginDepotStress) {
+  chainedOriginDepot.TestOnlyUnmap();
+  const int kThreads = 8;
+  const u32 kUniquePerThread = 500000;
+  const int kRepeat = 2;
+  std::atomic<int> ready = {};
+  auto thread = [&](u32 idx) {
+    ready++;
+    while (ready < kThreads) std::this_thread::yield();
+    for (int r = 0; r < kRepeat; r++) {
+      // A chain per store, with prev_id from the previous store,
+      // so that half of the puts find an existing chain.
+      u32 prev_id = idx;
+      for (u32 i = 0; i < kUniquePerThread; i++) {
+        u32 new_id;
+        chainedOriginDepot.Put(idx * kUniquePerThread + i / 2, prev_id,
+                               &new_id);
+        prev_id = new_id;
+      }
+    }
+  };
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kThreads; i++) threads.emplace_back(thread, i);
+  for (auto &t : threads) t.join();
+  EXPECT_GE(chainedOriginDepot.Size(), kThreads * kUniquePerThread);
+}
+
 }  // namespace __sanitizer
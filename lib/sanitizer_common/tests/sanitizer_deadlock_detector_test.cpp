@@ -411,6 +411,30 @@ TEST(DeadlockDetector, RecusriveLockTest) {
   RunRecusriveLockTest<BV2>();
 }
 
+template <class BV>
+void RunDeepRecursiveLockTest() {
+  ScopedDD<BV> sdd;
+  DeadlockDetector<BV> &d = *sdd.dp;
+  DeadlockDetectorTLS<BV> &dtls = sdd.dtls;
+
+  // Recursion deeper than the number of recursive locks remembered.
+  const uptr kDepth = 100;
+  uptr l0 = d.newNode(0);
+  uptr l1 = d.newNode(0);
+  for (uptr i = 0; i < kDepth; i++) EXPECT_FALSE(d.onLock(&dtls, l0));
+  for (uptr i = 1; i < kDepth; i++) d.onUnlock(&dtls, l0);
+  // l0 is still held once.
+  EXPECT_FALSE(d.onLock(&dtls, l1));
+  EXPECT_TRUE(d.testOnlyHasEdge(l0, l1));
+  d.onUnlock(&dtls, l1);
+  d.onUnlock(&dtls, l0);
+  EXPECT_TRUE(dtls.empty());
+}
+
+TEST(DeadlockDetector, DeepRecursiveLockTest) {
+  RunDeepRecursiveLockTest<BV2>();
+}
+
 template <class BV>
 void RunLockContextTest() {
   ScopedDD<BV> sdd;
@@ -184,6 +184,12 @@ public:
     Opt.MaxSimultaneousAllocations =
         getFlags()->GWP_ASAN_MaxSimultaneousAllocations;
     Opt.SampleRate = getFlags()->GWP_ASAN_SampleRate;
+    Opt.MaximumAllocationSize = getFlags()->GWP_ASAN_MaximumAllocationSize;
+    Opt.TargetSampledAllocationsPerSecond =
+        getFlags()->GWP_ASAN_TargetSampledAllocationsPerSecond;
+    Opt.TargetPoolOccupancyPercent =
+        getFlags()->GWP_ASAN_TargetPoolOccupancyPercent;
+    Opt.SizeClassWeighting = getFlags()->GWP_ASAN_SizeClassWeighting;
     Opt.InstallSignalHandlers = getFlags()->GWP_ASAN_InstallSignalHandlers;
     // Embedded GWP-ASan is locked through the Scudo atfork handler (via
     // Allocator::disable calling GWPASan.disable). Disable GWP-ASan's atfork
@@ -0,0 +1,58 @@
+// Mini-benchmark for tsan: acquire/release atomic operations on many
+// distinct atomic variables, which stresses sync object lookup/creation.
+#include <assert.h>
+#include <atomic>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+int n_vars;
+int n_iter;
+std::atomic<int> *vars;
+
+void *Thread(void *arg) {
+  long idx = (long)arg;
+  unsigned seed = idx;
+  for (int i = 0; i < n_iter; i++) {
+    std::atomic<int> &v = vars[rand_r(&seed) % n_vars];
+    switch (i % 4) {
+    case 0:
+      v.load(std::memory_order_acquire);
+      break;
+    case 1:
+      v.store(i, std::memory_order_release);
+      break;
+    case 2:
+      v.fetch_add(1, std::memory_order_acq_rel);
+      break;
+    case 3:
+      v.load(std::memory_order_relaxed);
+      break;
+    }
+  }
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  int n_threads = 4;
+  n_vars = 1000000;
+  n_iter = 10000000;
+  if (argc > 1)
+    n_threads = atoi(argv[1]);
+  if (argc > 2)
+    n_vars = atoi(argv[2]);
+  if (argc > 3)
+    n_iter = atoi(argv[3]);
+  assert(n_threads > 0 && n_vars > 0 && n_iter > 0);
+  printf("%s: n_threads=%d n_vars=%d n_iter=%d\n", __FILE__, n_threads, n_vars,
+         n_iter);
+  vars = new std::atomic<int>[n_vars]();
+  pthread_t *t = new pthread_t[n_threads];
+  for (int i = 0; i < n_threads; i++)
+    pthread_create(&t[i], 0, Thread, (void *)(long)i);
+  for (int i = 0; i < n_threads; i++)
+    pthread_join(t[i], 0);
+  delete[] t;
+  delete[] vars;
+  return 0;
+}
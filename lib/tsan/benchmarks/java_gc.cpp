@@ -0,0 +1,80 @@
+// Mini-benchmark for tsan Java interface: a copying GC over a 4GB heap.
+// Each cycle allocates objects in one semispace, then copies live objects
+// to the other semispace and frees dead ones.
+// First argument selects how the GC reports regions: 0 passes every region
+// in a separate __tsan_java_move/free call, 1 passes all of them in one
+// __tsan_java_move_regions and one __tsan_java_free_regions call.
+// Second optional argument is the number of GC cycles.
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+
+extern "C" {
+typedef unsigned long jptr;
+void __tsan_java_init(jptr heap_begin, jptr heap_size);
+int __tsan_java_fini();
+void __tsan_java_alloc(jptr ptr, jptr size);
+void __tsan_java_free(jptr ptr, jptr size);
+void __tsan_java_move(jptr src, jptr dst, jptr size);
+void __tsan_java_free_regions(const jptr *regions, jptr n);
+void __tsan_java_move_regions(const jptr *regions, jptr n);
+void __tsan_java_mutex_lock(jptr addr);
+void __tsan_java_mutex_unlock(jptr addr);
+}
+
+const jptr kHeapSize = 4ull << 30;
+const jptr kObjects = 4096;
+const jptr kObjectSize = 64 << 10;
+
+int main(int argc, char **argv) {
+  int mode = argc > 1 ? atoi(argv[1]) : 0;
+  int cycles = argc > 2 ? atoi(argv[2]) : 16;
+  printf("%s: mode=%d cycles=%d\n", __FILE__, mode, cycles);
+  char *heap = (char *)mmap(0, kHeapSize, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANON | MAP_NORESERVE, -1, 0);
+  if (heap == MAP_FAILED)
+    return printf("mmap failed\n");
+  __tsan_java_init((jptr)heap, kHeapSize);
+  const jptr kSpaceSize = kHeapSize / 2;
+  const jptr kStride = kSpaceSize / kObjects;
+  jptr *moves = new jptr[kObjects * 3];
+  jptr *frees = new jptr[kObjects * 2];
+  for (int cycle = 0; cycle < cycles; cycle++) {
+    jptr from = (jptr)heap + (cycle % 2) * kSpaceSize;
+    jptr to = (jptr)heap + (1 - cycle % 2) * kSpaceSize;
+    for (jptr i = 0; i < kObjects; i++) {
+      jptr obj = from + i * kStride;
+      __tsan_java_alloc(obj, kObjectSize);
+      __tsan_java_mutex_lock(obj + 16);
+      __tsan_java_mutex_unlock(obj + 16);
+    }
+    jptr nmoves = 0, nfrees = 0;
+    for (jptr i = 0; i < kObjects; i++) {
+      jptr obj = from + i * kStride;
+      if (i % 2 == 0) {
+        moves[nmoves * 3] = obj;
+        moves[nmoves * 3 + 1] = to + nmoves * kObjectSize;
+        moves[nmoves * 3 + 2] = kObjectSize;
+        nmoves++;
+      } else {
+        frees[nfrees * 2] = obj;
+        frees[nfrees * 2 + 1] = kObjectSize;
+        nfrees++;
+      }
+    }
+    if (mode == 0) {
+      for (jptr i = 0; i < nmoves; i++)
+        __tsan_java_move(moves[i * 3], moves[i * 3 + 1], moves[i * 3 + 2]);
+      for (jptr i = 0; i < nfrees; i++)
+        __tsan_java_free(frees[i * 2], frees[i * 2 + 1]);
+    } else {
+      __tsan_java_move_regions(moves, nmoves);
+      __tsan_java_free_regions(frees, nfrees);
+    }
+    // All survivors die before the next cycle.
+    __tsan_java_free(to, nmoves * kObjectSize);
+  }
+  delete[] moves;
+  delete[] frees;
+  return __tsan_java_fini();
+}
@@ -0,0 +1,127 @@
+// Mini-benchmark for tsan: atomics-heavy bounded MPMC queue.
+// The queue does mostly relaxed and acquire loads plus release stores
+// and relaxed CAS, which is typical for lock-free data structures.
+#include <assert.h>
+#include <atomic>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+class Queue {
+ public:
+  explicit Queue(size_t size) : cells_(new Cell[size]), mask_(size - 1) {
+    assert(size >= 2 && (size & (size - 1)) == 0);
+    for (size_t i = 0; i < size; i++)
+      cells_[i].seq.store(i, std::memory_order_relaxed);
+    enqueue_pos_.store(0, std::memory_order_relaxed);
+    dequeue_pos_.store(0, std::memory_order_relaxed);
+  }
+
+  ~Queue() { delete[] cells_; }
+
+  bool Enqueue(long data) {
+    Cell *cell;
+    size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+    for (;;) {
+      cell = &cells_[pos & mask_];
+      size_t seq = cell->seq.load(std::memory_order_acquire);
+      long diff = (long)seq - (long)pos;
+      if (diff == 0) {
+        if (enqueue_pos_.compare_exchange_weak(pos, pos + 1,
+                                               std::memory_order_relaxed))
+          break;
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = enqueue_pos_.load(std::memory_order_relaxed);
+      }
+    }
+    cell->data = data;
+    cell->seq.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool Dequeue(long *data) {
+    Cell *cell;
+    size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+    for (;;) {
+      cell = &cells_[pos & mask_];
+      size_t seq = cell->seq.load(std::memory_order_acquire);
+      long diff = (long)seq - (long)(pos + 1);
+      if (diff == 0) {
+        if (dequeue_pos_.compare_exchange_weak(pos, pos + 1,
+                                               std::memory_order_relaxed))
+          break;
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = dequeue_pos_.load(std::memory_order_relaxed);
+      }
+    }
+    *data = cell->data;
+    cell->seq.store(pos + mask_ + 1, std::memory_order_release);
+    return true;
+  }
+
+ private:
+  struct Cell {
+    std::atomic<size_t> seq;
+    long data;
+  };
+
+  Cell *const cells_;
+  const size_t mask_;
+  alignas(64) std::atomic<size_t> enqueue_pos_;
+  alignas(64) std::atomic<size_t> dequeue_pos_;
+};
+
+Queue *queue;
+int n_iter;
+std::atomic<long> total;
+
+void *Producer(void *arg) {
+  for (int i = 0; i < n_iter; i++) {
+    while (!queue->Enqueue(i)) {
+    }
+  }
+  return 0;
+}
+
+void *Consumer(void *arg) {
+  long sum = 0;
+  for (int i = 0; i < n_iter; i++) {
+    long v;
+    while (!queue->Dequeue(&v)) {
+    }
+    sum += v;
+  }
+  total.fetch_add(sum, std::memory_order_relaxed);
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  int n_threads = 2;
+  int size = 1024;
+  n_iter = 1000000;
+  if (argc > 1)
+    n_threads = atoi(argv[1]);
+  if (argc > 2)
+    size = atoi(argv[2]);
+  if (argc > 3)
+    n_iter = atoi(argv[3]);
+  assert(n_threads > 0 && n_iter > 0);
+  printf("%s: n_threads=%d size=%d n_iter=%d\n", __FILE__, n_threads, size,
+         n_iter);
+  queue = new Queue(size);
+  pthread_t *t = new pthread_t[2 * n_threads];
+  for (int i = 0; i < n_threads; i++) {
+    pthread_create(&t[2 * i], 0, Producer, 0);
+    pthread_create(&t[2 * i + 1], 0, Consumer, 0);
+  }
+  for (int i = 0; i < 2 * n_threads; i++)
+    pthread_join(t[i], 0);
+  assert(total == (long)n_threads * n_iter * (n_iter - 1) / 2);
+  delete[] t;
+  delete queue;
+  return 0;
+}
@@ -0,0 +1,62 @@
+// Mini-benchmark for tsan: latency of race reports with a long history.
+// Each thread fills its trace with unrelated events and then races on
+// a distinct address, so every race needs a trace replay to restore
+// the previous stack.
+// Only the first report is printed (the rest have equal stacks),
+// but all of them go through trace replay.
+// Run with different history_size values, e.g.:
+//   TSAN_OPTIONS="history_size=7" ./a.out 4 1000
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+const int kMaxRaces = 1 << 16;
+int n_races;
+int n_fill;
+volatile int racy[kMaxRaces];
+int *local;
+pthread_barrier_t barrier;
+
+__attribute__((noinline)) void Fill(int *p) {
+  for (int i = 0; i < n_fill; i++)
+    p[i % 1024] = i;
+}
+
+__attribute__((noinline)) void Race(int i) { racy[i]++; }
+
+void *Thread(void *arg) {
+  long idx = (long)arg;
+  int *p = local + idx * 1024;
+  for (int i = 0; i < n_races; i++) {
+    Race(i);
+    Fill(p);
+    pthread_barrier_wait(&barrier);
+  }
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  int n_threads = 2;
+  n_races = 1000;
+  n_fill = 1000000;
+  if (argc > 1)
+    n_threads = atoi(argv[1]);
+  if (argc > 2)
+    n_races = atoi(argv[2]);
+  if (argc > 3)
+    n_fill = atoi(argv[3]);
+  assert(n_threads > 1 && n_races > 0 && n_races <= kMaxRaces);
+  printf("%s: n_threads=%d n_races=%d n_fill=%d\n", __FILE__, n_threads,
+         n_races, n_fill);
+  pthread_barrier_init(&barrier, 0, n_threads);
+  local = new int[n_threads * 1024];
+  pthread_t *t = new pthread_t[n_threads];
+  for (int i = 0; i < n_threads; i++)
+    pthread_create(&t[i], 0, Thread, (void *)(long)i);
+  for (int i = 0; i < n_threads; i++)
+    pthread_join(t[i], 0);
+  delete[] t;
+  delete[] local;
+  return 0;
+}
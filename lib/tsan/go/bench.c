@@ -0,0 +1,108 @@
+//===-- bench.c -----------------------------------------------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// Benchmark for Go runtime: per-access calls vs __tsan_access_batch.
+// Built and run by buildgo.sh with BENCH=1.
+//
+//===----------------------------------------------------------------------===//
+
+#include <sys/mman.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+void __tsan_init(void **thr, void **proc, void (*cb)(long, void*));
+void __tsan_fini();
+void __tsan_map_shadow(void *addr, unsigned long size);
+void __tsan_read(void *thr, void *addr, void *pc);
+void __tsan_write(void *thr, void *addr, void *pc);
+void __tsan_access_batch(void *thr, void *accesses, unsigned long n);
+void __tsan_func_enter(void *thr, void *pc);
+void __tsan_func_exit(void *thr);
+void __tsan_malloc(void *thr, void *pc, void *p, unsigned long sz);
+
+void *current_proc;
+
+void symbolize_cb(long cmd, void *ctx) {
+  switch (cmd) {
+  case 0:
+    if (current_proc == 0)
+      abort();
+    *(void**)ctx = current_proc;
+  }
+}
+
+// See test.c.
+void *go_heap = (void *)0xC011110000;
+
+void foobar() {}
+
+enum { kAccesses = 64, kIters = 100000, kHeapSize = 1 << 20 };
+
+struct access {
+  void *addr;
+  unsigned long size;
+  void *pc;
+  unsigned long is_write;
+};
+
+static unsigned long long now() {
+  struct timespec tp;
+  clock_gettime(CLOCK_MONOTONIC, &tp);
+  return tp.tv_sec * 1000000000ULL + tp.tv_nsec;
+}
+
+int main(void) {
+  void *thr = 0;
+  void *proc = 0;
+  __tsan_init(&thr, &proc, symbolize_cb);
+  current_proc = proc;
+  char *buf0 = mmap(go_heap, kHeapSize, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_FIXED | MAP_ANON, -1, 0);
+  if (buf0 == MAP_FAILED) {
+    fprintf(stderr, "failed to allocate Go-like heap at %p; errno %d\n",
+            go_heap, errno);
+    return 1;
+  }
+  char *buf = (char*)((unsigned long)buf0 + (64<<10) - 1 & ~((64<<10) - 1));
+  unsigned long size = kAccesses * 8;
+  __tsan_map_shadow(buf, size);
+  __tsan_malloc(thr, (char*)&foobar + 1, buf, size);
+  __tsan_func_enter(thr, (char*)&main + 1);
+
+  struct access batch[kAccesses];
+  for (int i = 0; i < kAccesses; i++) {
+    batch[i].addr = buf + i * 8;
+    batch[i].size = 1;
+    batch[i].pc = (char*)&foobar + 1 + i % 4;
+    batch[i].is_write = i % 2;
+  }
+
+  unsigned long long t0 = now();
+  for (int iter = 0; iter < kIters; iter++) {
+    for (int i = 0; i < kAccesses; i++) {
+      if (batch[i].is_write)
+        __tsan_write(thr, batch[i].addr, batch[i].pc);
+      else
+        __tsan_read(thr, batch[i].addr, batch[i].pc);
+    }
+  }
+  unsigned long long t1 = now();
+  for (int iter = 0; iter < kIters; iter++)
+    __tsan_access_batch(thr, batch, kAccesses);
+  unsigned long long t2 = now();
+
+  fprintf(stderr, "per-access: %.2f ns/access\n",
+          (double)(t1 - t0) / kIters / kAccesses);
+  fprintf(stderr, "batched:    %.2f ns/access\n",
+          (double)(t2 - t1) / kIters / kAccesses);
+  __tsan_func_exit(thr);
+  __tsan_fini();
+  return 0;
+}
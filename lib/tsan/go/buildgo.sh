@@ -212,3 +212,8 @@ if [ "$SILENT" != "1" ]; then
 else
   $DIR/test 2>/dev/null
 fi
+
+if [ "$BENCH" = "1" ]; then
+  $CC $OSCFLAGS $ARCHCFLAGS -O2 bench.c $DIR/race_$SUFFIX.syso -g -o $DIR/bench $OSLDFLAGS $LDFLAGS
+  $DIR/bench
+fi
@@ -26,6 +26,7 @@ void __tsan_proc_wire(void *proc, void *thr);
 void __tsan_proc_unwire(void *proc, void *thr);
 void __tsan_read(void *thr, void *addr, void *pc);
 void __tsan_write(void *thr, void *addr, void *pc);
+void __tsan_access_batch(void *thr, void *accesses, unsigned long n);
 void __tsan_func_enter(void *thr, void *pc);
 void __tsan_func_exit(void *thr);
 void __tsan_malloc(void *thr, void *pc, void *p, unsigned long sz);
@@ -88,6 +89,17 @@ int main(void) {
   __tsan_func_enter(thr1, (char*)&foobar + 1);
   __tsan_func_enter(thr1, (char*)&foobar + 1);
   __tsan_write(thr1, buf, (char*)&barfoo + 1);
+  struct {
+    void *addr;
+    unsigned long size;
+    void *pc;
+    unsigned long is_write;
+  } batch[] = {
+      {buf + 8, 1, (char*)&barfoo + 1, 1},
+      {buf + 16, 1, (char*)&barfoo + 2, 0},
+      {buf + 20, 1, (char*)&barfoo + 3, 1},
+  };
+  __tsan_access_batch(thr1, batch, sizeof(batch) / sizeof(batch[0]));
   __tsan_acquire(thr1, buf);
   __tsan_func_exit(thr1);
   __tsan_func_exit(thr1);
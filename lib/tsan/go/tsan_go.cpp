@@ -198,6 +198,10 @@ void __tsan_write_range(ThreadState *thr, void *addr, uptr size, uptr pc) {
   MemoryAccessRange(thr, (uptr)pc, (uptr)addr, size, true);
 }
 
+void __tsan_access_batch(ThreadState *thr, BatchAccess *accesses, uptr n) {
+  MemoryAccessBatch(thr, accesses, n);
+}
+
 void __tsan_func_enter(ThreadState *thr, void *pc) {
   FuncEntry(thr, (uptr)pc);
 }
@@ -43,10 +43,31 @@ struct FdContext {
   FdSync filesync;
   FdSync socksync;
   u64 connectsync;
+  // Number of releases to each shared sync object (see sharedidx).
+  atomic_uint64_t shared_releases[kFdSharedSyncs];
 };
 
 static FdContext fdctx;
 
+// Sync objects shared by all fds of a kind. All socket operations in the
+// process acquire and release them, so with io_sync_batch a thread skips
+// acquires that can't give it anything new: the ones where nothing was
+// released to the object since this thread last acquired or released it.
+//
+// Returns index of s in fdctx.shared_releases and thr->fd_sync_seen,
+// or -1 if s is not a shared sync object or batching is disabled.
+static int sharedidx(FdSync *s) {
+  if (!flags()->io_sync_batch)
+    return -1;
+  FdSync *syncs[kFdSharedSyncs] = {&fdctx.globsync, &fdctx.filesync,
+                                   &fdctx.socksync};
+  for (int i = 0; i < kFdSharedSyncs; i++) {
+    if (s == syncs[i])
+      return i;
+  }
+  return -1;
+}
+
 static bool bogusfd(int fd) {
   // Apparently a bogus fd value.
   return fd < 0 || fd >= kTableSize;
@@ -179,8 +200,18 @@ void FdAcquire(ThreadState *thr, uptr pc, int fd) {
   FdSync *s = d->sync;
   DPrintf("#%d: FdAcquire(%d) -> %p\n", thr->tid, fd, s);
   MemoryAccess(thr, pc, (uptr)d, 8, kAccessRead);
-  if (s)
-    Acquire(thr, pc, (uptr)s);
+  if (!s)
+    return;
+  int idx = sharedidx(s);
+  if (idx >= 0) {
+    // Releases bump the counter before the fd operation that makes them
+    // visible to us, so an unchanged counter means s has nothing new.
+    u64 seen = atomic_load(&fdctx.shared_releases[idx], memory_order_acquire);
+    if (seen == thr->fd_sync_seen[idx])
+      return;
+    thr->fd_sync_seen[idx] = seen;
+  }
+  Acquire(thr, pc, (uptr)s);
 }
 
 void FdRelease(ThreadState *thr, uptr pc, int fd) {
@@ -190,8 +221,18 @@ void FdRelease(ThreadState *thr, uptr pc, int fd) {
   FdSync *s = d->sync;
   DPrintf("#%d: FdRelease(%d) -> %p\n", thr->tid, fd, s);
   MemoryAccess(thr, pc, (uptr)d, 8, kAccessRead);
-  if (s)
+  if (s) {
     Release(thr, pc, (uptr)s);
+    int idx = sharedidx(s);
+    if (idx >= 0) {
+      u64 prev = atomic_fetch_add(&fdctx.shared_releases[idx], 1,
+                                  memory_order_release);
+      // If the only release since our last acquire is this one, s holds
+      // nothing we don't have.
+      if (prev == thr->fd_sync_seen[idx])
+        thr->fd_sync_seen[idx] = prev + 1;
+    }
+  }
   if (uptr aux_sync = atomic_load(&d->aux_sync, memory_order_acquire))
     Release(thr, pc, aux_sync);
 }
@@ -234,7 +234,13 @@ static T AtomicLoad(ThreadState *thr, uptr pc, const volatile T *a, morder mo) {
   // pointer is initialized to nullptr and then periodically acquire-loaded.
   T v = NoTsanAtomicLoad(a, mo);
   SyncVar *s = ctx->metamap.GetSyncIfExists((uptr)a);
-  if (s) {
+  // If nothing was released to the sync object yet (e.g. it was created
+  // by acquire-only RMW operations), there is nothing to acquire and we
+  // don't need to lock it. Releasing operations set the clock before
+  // storing the value, so if the acquire load above observed a released
+  // value, it also observes the clock.
+  if (s && atomic_load_relaxed(
+               reinterpret_cast<atomic_uintptr_t *>(&s->clock))) {
     SlotLocker locker(thr);
     ReadLock lock(&s->mtx);
     thr->clock.Acquire(s->clock);
@@ -426,6 +432,10 @@ static bool AtomicCAS(ThreadState *thr, uptr pc, volatile T *a, T *c, T v,
   {
     auto s = ctx->metamap.GetSyncOrCreate(thr, pc, (uptr)a, false);
     RWLock lock(&s->mtx, release);
+    // AtomicLoad relies on the clock being non-null before a released value
+    // becomes visible, but we release after the CAS, so allocate it before.
+    if (release && !s->clock)
+      s->clock = New<VectorClock>();
     T cc = *c;
     T pr = func_cas(a, cc, v);
     success = pr == cc;
@@ -54,6 +54,38 @@ MBlock *JavaHeapBlock(uptr addr, uptr *start) {
   return nullptr;
 }
 
+static void JavaFree(ThreadState *thr, jptr ptr, jptr size) {
+  DCHECK_NE(size, 0);
+  DCHECK_EQ(ptr % kHeapAlignment, 0);
+  DCHECK_EQ(size % kHeapAlignment, 0);
+  DCHECK_GE(ptr, jctx->heap_begin);
+  DCHECK_LE(ptr + size, jctx->heap_begin + jctx->heap_size);
+
+  ctx->metamap.FreeRange(thr->proc(), ptr, size, false);
+}
+
+static void JavaMove(ThreadState *thr, jptr src, jptr dst, jptr size) {
+  DCHECK_NE(size, 0);
+  DCHECK_EQ(src % kHeapAlignment, 0);
+  DCHECK_EQ(dst % kHeapAlignment, 0);
+  DCHECK_EQ(size % kHeapAlignment, 0);
+  DCHECK_GE(src, jctx->heap_begin);
+  DCHECK_LE(src + size, jctx->heap_begin + jctx->heap_size);
+  DCHECK_GE(dst, jctx->heap_begin);
+  DCHECK_LE(dst + size, jctx->heap_begin + jctx->heap_size);
+  DCHECK_NE(dst, src);
+
+  // Assuming it's not running concurrently with threads that do
+  // memory accesses and mutex operations (stop-the-world phase).
+  ctx->metamap.MoveMemory(src, dst, size);
+
+  // Clear the destination shadow range.
+  // We used to move shadow from src to dst, but the trace format does not
+  // support that anymore as it contains addresses of accesses.
+  // For large ranges this remaps the shadow instead of clearing it.
+  MemoryResetRange(thr, 0, dst, size);
+}
+
 }  // namespace __tsan
 
 #define JAVA_FUNC_ENTER(func)      \
@@ -100,40 +132,30 @@ void __tsan_java_free(jptr ptr, jptr size) {
   JAVA_FUNC_ENTER(__tsan_java_free);
   DPrintf("#%d: java_free(0x%zx, 0x%zx)\n", thr->tid, ptr, size);
   DCHECK_NE(jctx, 0);
-  DCHECK_NE(size, 0);
-  DCHECK_EQ(ptr % kHeapAlignment, 0);
-  DCHECK_EQ(size % kHeapAlignment, 0);
-  DCHECK_GE(ptr, jctx->heap_begin);
-  DCHECK_LE(ptr + size, jctx->heap_begin + jctx->heap_size);
+  JavaFree(thr, ptr, size);
+}
 
-  ctx->metamap.FreeRange(thr->proc(), ptr, size, false);
+void __tsan_java_free_regions(const jptr *regions, jptr n) {
+  JAVA_FUNC_ENTER(__tsan_java_free_regions);
+  DPrintf("#%d: java_free_regions(%p, %zu)\n", thr->tid, regions, n);
+  DCHECK_NE(jctx, 0);
+  for (jptr i = 0; i < n; i++)
+    JavaFree(thr, regions[2 * i], regions[2 * i + 1]);
 }
 
 void __tsan_java_move(jptr src, jptr dst, jptr size) {
   JAVA_FUNC_ENTER(__tsan_java_move);
   DPrintf("#%d: java_move(0x%zx, 0x%zx, 0x%zx)\n", thr->tid, src, dst, size);
   DCHECK_NE(jctx, 0);
-  DCHECK_NE(size, 0);
-  DCHECK_EQ(src % kHeapAlignment, 0);
-  DCHECK_EQ(dst % kHeapAlignment, 0);
-  DCHECK_EQ(size % kHeapAlignment, 0);
-  DCHECK_GE(src, jctx->heap_begin);
-  DCHECK_LE(src + size, jctx->heap_begin + jctx->heap_size);
-  DCHECK_GE(dst, jctx->heap_begin);
-  DCHECK_LE(dst + size, jctx->heap_begin + jctx->heap_size);
-  DCHECK_NE(dst, src);
-  DCHECK_NE(size, 0);
-
-  // Assuming it's not running concurrently with threads that do
-  // memory accesses and mutex operations (stop-the-world phase).
-  ctx->metamap.MoveMemory(src, dst, size);
+  JavaMove(thr, src, dst, size);
+}
 
-  // Clear the destination shadow range.
-  // We used to move shadow from src to dst, but the trace format does not
-  // support that anymore as it contains addresses of accesses.
-  RawShadow *d = MemToShadow(dst);
-  RawShadow *dend = MemToShadow(dst + size);
-  ShadowSet(d, dend, Shadow::kEmpty);
+void __tsan_java_move_regions(const jptr *regions, jptr n) {
+  JAVA_FUNC_ENTER(__tsan_java_move_regions);
+  DPrintf("#%d: java_move_regions(%p, %zu)\n", thr->tid, regions, n);
+  DCHECK_NE(jctx, 0);
+  for (jptr i = 0; i < n; i++)
+    JavaMove(thr, regions[3 * i], regions[3 * i + 1], regions[3 * i + 2]);
 }
 
 jptr __tsan_java_find(jptr *from_ptr, jptr to) {
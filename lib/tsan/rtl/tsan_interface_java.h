@@ -51,6 +51,12 @@ void __tsan_java_free(jptr ptr, jptr size) INTERFACE_ATTRIBUTE;
 // Can be aggregated for several objects (preferably).
 // The ranges can overlap.
 void __tsan_java_move(jptr src, jptr dst, jptr size) INTERFACE_ATTRIBUTE;
+// Bulk versions of __tsan_java_free/__tsan_java_move for GCs that produce
+// lists of regions. regions contains n (ptr, size) pairs for free and
+// n (src, dst, size) triples for move, which are processed in order.
+// Several GC threads can process disjoint lists of regions concurrently.
+void __tsan_java_free_regions(const jptr *regions, jptr n) INTERFACE_ATTRIBUTE;
+void __tsan_java_move_regions(const jptr *regions, jptr n) INTERFACE_ATTRIBUTE;
 // This function must be called on the finalizer thread
 // before executing a batch of finalizers.
 // It ensures necessary synchronization between
@@ -180,6 +180,7 @@ static void DoResetImpl(uptr epoch) {
     if (tctx->thr && !tctx->thr->slot) {
       atomic_store_relaxed(&tctx->thr->trace_pos, 0);
       tctx->thr->trace_prev_pc = 0;
+      tctx->thr->trace_pending_func = 0;
     }
     if (trace->parts_allocated > trace->parts.Size()) {
       ctx->trace_part_finished_excess +=
@@ -221,6 +222,8 @@ static void DoResetImpl(uptr epoch) {
   DPrintf("Resetting meta shadow...\n");
   ctx->metamap.ResetClocks();
   StoreShadow(&ctx->last_spurious_race, Shadow::kEmpty);
+  // Sids/epochs are reused after reset, so the racy filter keys become stale.
+  ctx->racy_filter.Reset();
   ctx->resetting = false;
 }
 
@@ -332,6 +335,7 @@ static void SlotDetachImpl(ThreadState* thr, bool exiting) {
         thr->tctx->trace.local_head = nullptr;
         atomic_store_relaxed(&thr->trace_pos, 0);
         thr->trace_prev_pc = 0;
+        thr->trace_pending_func = 0;
       }
       if (part) {
         Lock l(&ctx->slot_mtx);
@@ -792,6 +796,9 @@ int Finalize(ThreadState *thr) {
 #endif
   }
 
+  if (u64 dropped = atomic_load_relaxed(&ctx->racy_filter.dropped))
+    VPrintf(1, "ThreadSanitizer: dropped %llu duplicate race(s)\n", dropped);
+
   if (common_flags()->print_suppressions)
     PrintMatchedSuppressions();
 
@@ -944,6 +951,7 @@ void TraceSwitchPart(ThreadState* thr) {
     if (part) {
       atomic_store_relaxed(&thr->trace_pos,
                            reinterpret_cast<uptr>(&part->events[0]));
+      thr->trace_pending_func = 0;
       return;
     }
   }
@@ -957,6 +965,7 @@ void TraceSwitchPartImpl(ThreadState* thr) {
   TracePart* part = TracePartAlloc(thr);
   part->trace = trace;
   thr->trace_prev_pc = 0;
+  thr->trace_pending_func = 0;
   TracePart* recycle = nullptr;
   // Keep roughly half of parts local to the thread
   // (not queued into the recycle queue).
@@ -154,6 +154,9 @@ struct TidSlot {
   TidSlot();
 } ALIGNED(SANITIZER_CACHE_LINE_SIZE);
 
+// Number of fd sync objects shared by all fds of a kind (see tsan_fd.cpp).
+const int kFdSharedSyncs = 3;
+
 // This struct is stored in TLS.
 struct ThreadState {
   FastState fast_state;
@@ -167,6 +170,10 @@ struct ThreadState {
   atomic_uintptr_t trace_pos;
   // PC of the last memory access, used to compute PC deltas in the trace.
   uptr trace_prev_pc;
+  // PC of the last function entry that is not in the trace yet, or 0.
+  // The entry event is written only before the next event, so calls that
+  // don't produce any events don't use trace space (see FuncExit).
+  uptr trace_pending_func;
 
   // Technically `current` should be a separate THREADLOCAL variable;
   // but it is placed here in order to share cache line with previous fields.
@@ -223,6 +230,10 @@ struct ThreadState {
 #if !SANITIZER_GO
   StackID last_sleep_stack_id;
   VectorClock last_sleep_clock;
+
+  // Release counts of shared fd sync objects as of the last acquire
+  // (see tsan_fd.cpp).
+  u64 fd_sync_seen[kFdSharedSyncs];
 #endif
 
   // Set in regions of runtime that must be signal-safe and fork-safe.
@@ -284,6 +295,24 @@ struct RacyStacks {
   bool operator==(const RacyStacks &other) const;
 };
 
+// Lock-free set of keys of races that were already reported or found in
+// racy_stacks (see RacyFilterKey). ReportRace consults it before taking any
+// locks, so that a hot race does not serialize all threads on the slot and
+// registry mutexes. The keys contain epochs, so the set is cleared on reset.
+// The set is lossy: when a probe sequence is full, an old entry is
+// overwritten and the corresponding race takes the slow path again.
+struct RacyFilter {
+  static constexpr uptr kSize = 4096;
+  static constexpr uptr kProbes = 4;
+  atomic_uint64_t hashes[kSize];
+  // Number of races dropped as duplicates.
+  atomic_uint64_t dropped;
+
+  bool Contains(u64 hash);
+  void Add(u64 hash);
+  void Reset();
+};
+
 struct RacyAddress {
   uptr addr_min;
   uptr addr_max;
@@ -351,6 +380,7 @@ struct Context {
 
   Mutex racy_mtx;
   Vector<RacyStacks> racy_stacks;
+  RacyFilter racy_filter;
   // Number of fired suppressions may be large enough.
   Mutex fired_suppressions_mtx;
   InternalMmapVector<FiredSuppression> fired_suppressions;
@@ -540,6 +570,18 @@ void MemoryAccessRange(ThreadState *thr, uptr pc, uptr addr, uptr size,
     MemoryAccessRangeT<true>(thr, pc, addr, size);
 }
 
+// A memory access passed to MemoryAccessBatch.
+struct BatchAccess {
+  uptr addr;
+  uptr size;
+  uptr pc;
+  uptr is_write;
+};
+
+// Handles n accesses in one call, used by the Go runtime
+// to amortize the transition to the race runtime.
+void MemoryAccessBatch(ThreadState *thr, const BatchAccess *accesses, uptr n);
+
 void ShadowSet(RawShadow *p, RawShadow *end, RawShadow v);
 void MemoryRangeFreed(ThreadState *thr, uptr pc, uptr addr, uptr size);
 void MemoryResetRange(ThreadState *thr, uptr pc, uptr addr, uptr size);
@@ -720,18 +762,6 @@ ALWAYS_INLINE void TraceRelease(ThreadState *thr, EventT *evp) {
   atomic_store_relaxed(&thr->trace_pos, (uptr)(evp + 1));
 }
 
-template <typename EventT>
-void TraceEvent(ThreadState *thr, EventT ev) {
-  EventT *evp;
-  if (!TraceAcquire(thr, &evp)) {
-    TraceSwitchPart(thr);
-    UNUSED bool res = TraceAcquire(thr, &evp);
-    DCHECK(res);
-  }
-  *evp = ev;
-  TraceRelease(thr, evp);
-}
-
 ALWAYS_INLINE WARN_UNUSED_RESULT bool TryTraceFunc(ThreadState *thr,
                                                    uptr pc = 0) {
   if (!kCollectHistory)
@@ -746,6 +776,30 @@ ALWAYS_INLINE WARN_UNUSED_RESULT bool TryTraceFunc(ThreadState *thr,
   return true;
 }
 
+// Writes the pending function entry event, if any.
+// Must be called before adding any other event to the trace.
+ALWAYS_INLINE WARN_UNUSED_RESULT bool TryTracePendingFunc(
+    ThreadState *thr) {
+  if (LIKELY(!thr->trace_pending_func))
+    return true;
+  if (UNLIKELY(!TryTraceFunc(thr, thr->trace_pending_func)))
+    return false;
+  thr->trace_pending_func = 0;
+  return true;
+}
+
+template <typename EventT>
+void TraceEvent(ThreadState *thr, EventT ev) {
+  EventT *evp;
+  if (!TryTracePendingFunc(thr) || !TraceAcquire(thr, &evp)) {
+    TraceSwitchPart(thr);
+    UNUSED bool res = TryTracePendingFunc(thr) && TraceAcquire(thr, &evp);
+    DCHECK(res);
+  }
+  *evp = ev;
+  TraceRelease(thr, evp);
+}
+
 WARN_UNUSED_RESULT
 bool TryTraceMemoryAccess(ThreadState *thr, uptr pc, uptr addr, uptr size,
                           AccessType typ);
@@ -768,8 +822,13 @@ void GrowShadowStack(ThreadState *thr);
 ALWAYS_INLINE
 void FuncEntry(ThreadState *thr, uptr pc) {
   DPrintf2("#%d: FuncEntry %p\n", (int)thr->fast_state.sid(), (void *)pc);
-  if (UNLIKELY(!TryTraceFunc(thr, pc)))
-    return TraceRestartFuncEntry(thr, pc);
+  // The entry event is not written until the function produces an event.
+  // Only the entry of the caller is written now, if it is still pending.
+  if (kCollectHistory) {
+    if (UNLIKELY(!TryTracePendingFunc(thr)))
+      return TraceRestartFuncEntry(thr, pc);
+    thr->trace_pending_func = pc;
+  }
   DCHECK_GE(thr->shadow_stack_pos, thr->shadow_stack);
 #if !SANITIZER_GO
   DCHECK_LT(thr->shadow_stack_pos, thr->shadow_stack_end);
@@ -784,8 +843,13 @@ void FuncEntry(ThreadState *thr, uptr pc) {
 ALWAYS_INLINE
 void FuncExit(ThreadState *thr) {
   DPrintf2("#%d: FuncExit\n", (int)thr->fast_state.sid());
-  if (UNLIKELY(!TryTraceFunc(thr, 0)))
+  if (thr->trace_pending_func) {
+    // The function did not produce any events, so neither its entry
+    // nor its exit is needed for trace replay.
+    thr->trace_pending_func = 0;
+  } else if (UNLIKELY(!TryTraceFunc(thr, 0))) {
     return TraceRestartFuncExit(thr);
+  }
   DCHECK_GT(thr->shadow_stack_pos, thr->shadow_stack);
 #if !SANITIZER_GO
   DCHECK_LT(thr->shadow_stack_pos, thr->shadow_stack_end);
@@ -22,7 +22,7 @@ ALWAYS_INLINE USED bool TryTraceMemoryAccess(ThreadState* thr, uptr pc,
   if (!kCollectHistory)
     return true;
   EventAccess* ev;
-  if (UNLIKELY(!TraceAcquire(thr, &ev)))
+  if (UNLIKELY(!TryTracePendingFunc(thr) || !TraceAcquire(thr, &ev)))
     return false;
   u64 size_log = size == 1 ? 0 : size == 2 ? 1 : size == 4 ? 2 : 3;
   uptr pc_delta = pc - thr->trace_prev_pc + (1 << (EventAccess::kPCBits - 1));
@@ -59,7 +59,7 @@ bool TryTraceMemoryAccessRange(ThreadState* thr, uptr pc, uptr addr, uptr size,
   if (!kCollectHistory)
     return true;
   EventAccessRange* ev;
-  if (UNLIKELY(!TraceAcquire(thr, &ev)))
+  if (UNLIKELY(!TryTracePendingFunc(thr) || !TraceAcquire(thr, &ev)))
     return false;
   thr->trace_prev_pc = pc;
   ev->is_access = 0;
@@ -522,6 +522,24 @@ SECOND:
   CheckRaces(thr, shadow_mem, cur, shadow, access, typ);
 }
 
+void MemoryAccessBatch(ThreadState* thr, const BatchAccess* accesses, uptr n) {
+  if (UNLIKELY(thr->fast_state.GetIgnoreBit()))
+    return;
+  for (uptr i = 0; i < n; i++) {
+    const BatchAccess& a = accesses[i];
+    // Go instruments most accesses as 1-byte accesses, give them
+    // the inlined fast path with constant size and type.
+    if (LIKELY(a.size == 1)) {
+      if (a.is_write)
+        MemoryAccess(thr, a.pc, a.addr, 1, kAccessWrite);
+      else
+        MemoryAccess(thr, a.pc, a.addr, 1, kAccessRead);
+    } else {
+      MemoryAccessRange(thr, a.pc, a.addr, a.size, a.is_write);
+    }
+  }
+}
+
 void ShadowSet(RawShadow* p, RawShadow* end, RawShadow v) {
   DCHECK_LE(p, end);
   DCHECK(IsShadowMem(p));
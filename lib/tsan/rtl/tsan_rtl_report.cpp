@@ -14,6 +14,7 @@
 #include "sanitizer_common/sanitizer_placement_new.h"
 #include "sanitizer_common/sanitizer_stackdepot.h"
 #include "sanitizer_common/sanitizer_common.h"
+#include "sanitizer_common/sanitizer_hash.h"
 #include "sanitizer_common/sanitizer_stacktrace.h"
 #include "tsan_platform.h"
 #include "tsan_rtl.h"
@@ -349,13 +350,41 @@ ScopedReport::ScopedReport(ReportType typ, uptr tag)
 
 ScopedReport::~ScopedReport() {}
 
+// Returns the part to start replay of the trace from when searching for
+// events of sid/epoch. Each trace part starts with the current time followed
+// by the current stack and mutex set (see TraceSwitchPartImpl), so the part
+// is self-sufficient and can serve as a replay checkpoint. Epochs of a slot
+// only grow, so if a part starts at an epoch of sid that is before the target
+// epoch, all previous parts can't contain the target event.
+static TracePart *TraceReplayStart(Trace *trace, TracePart *last,
+                                   Event *last_pos, Sid sid, Epoch epoch) {
+  TracePart *start = trace->parts.Front();
+  for (TracePart *part = start; part != last;) {
+    part = trace->parts.Next(part);
+    CHECK(part);
+    // The current part may be reused from another trace and not yet contain
+    // the initial time event.
+    if (part == last && last_pos == &part->events[0])
+      break;
+    Event *evp = &part->events[0];
+    if (evp->is_access || evp->is_func || evp->type != EventType::kTime)
+      continue;
+    auto *ev = reinterpret_cast<EventTime *>(evp);
+    if (static_cast<Sid>(ev->sid) == sid &&
+        static_cast<Epoch>(ev->epoch) < epoch)
+      start = part;
+  }
+  return start;
+}
+
 // Replays the trace up to last_pos position in the last part
 // or up to the provided epoch/sid (whichever is earlier)
 // and calls the provided function f for each event.
+// Replay starts from the latest part that can contain the event.
 template <typename Func>
 void TraceReplay(Trace *trace, TracePart *last, Event *last_pos, Sid sid,
                  Epoch epoch, Func f) {
-  TracePart *part = trace->parts.Front();
+  TracePart *part = TraceReplayStart(trace, last, last_pos, sid, epoch);
   Sid ev_sid = kFreeSid;
   Epoch ev_epoch = kEpochOver;
   for (;;) {
@@ -611,6 +640,22 @@ static bool FindRacyStacks(const RacyStacks &hash) {
   return false;
 }
 
+// Returns the key of the race for ctx->racy_filter. It only uses data
+// available before any lock is taken: the current stack, the address and
+// the shadow value of the previous access. The previous access's stack is
+// not known yet, so it is identified by its slot, epoch, offset, size and
+// type, which is also all that RestoreStack uses to find it.
+static u64 RacyFilterKey(const VarSizeStackTrace &trace, uptr addr,
+                         Shadow old) {
+  MD5Hash stack = md5_hash(trace.trace, trace.size * sizeof(uptr));
+  MurMur2Hash64Builder hash;
+  hash.add(stack.hash[0]);
+  hash.add(stack.hash[1]);
+  hash.add(addr);
+  hash.add(static_cast<u64>(old.raw()));
+  return hash.get();
+}
+
 static bool HandleRacyStacks(ThreadState *thr, VarSizeStackTrace traces[2]) {
   if (!flags()->suppress_equal_stacks)
     return false;
@@ -629,6 +674,34 @@ static bool HandleRacyStacks(ThreadState *thr, VarSizeStackTrace traces[2]) {
   return false;
 }
 
+bool RacyFilter::Contains(u64 hash) {
+  hash = hash ? hash : 1;
+  for (uptr i = 0; i < kProbes; i++) {
+    u64 v = atomic_load_relaxed(&hashes[(hash + i) % kSize]);
+    if (v == hash)
+      return true;
+    if (v == 0)
+      return false;
+  }
+  return false;
+}
+
+void RacyFilter::Add(u64 hash) {
+  hash = hash ? hash : 1;
+  for (uptr i = 0; i < kProbes; i++) {
+    atomic_uint64_t *p = &hashes[(hash + i) % kSize];
+    u64 cmp = 0;
+    if (atomic_compare_exchange_strong(p, &cmp, hash, memory_order_relaxed) ||
+        cmp == hash)
+      return;
+  }
+  atomic_store_relaxed(&hashes[hash % kSize], hash);
+}
+
+void RacyFilter::Reset() {
+  for (uptr i = 0; i < kSize; i++) atomic_store_relaxed(&hashes[i], 0);
+}
+
 bool OutputReport(ThreadState *thr, const ScopedReport &srep) {
   // These should have been checked in ShouldReport.
   // It's too late to check them here, we have already taken locks.
@@ -759,6 +832,16 @@ void ReportRace(ThreadState *thr, RawShadow *shadow_mem, Shadow cur, Shadow old,
   if (IsFiredSuppression(ctx, rep_typ, traces[0]))
     return;
 
+  // A race that was already handled is dropped before taking any locks.
+  u64 filter_key = 0;
+  if (flags()->suppress_equal_stacks) {
+    filter_key = RacyFilterKey(traces[0], addr0, old);
+    if (ctx->racy_filter.Contains(filter_key)) {
+      atomic_fetch_add(&ctx->racy_filter.dropped, 1, memory_order_relaxed);
+      return;
+    }
+  }
+
   DynamicMutexSet mset1;
   MutexSet *mset[kMop] = {&thr->mset, mset1};
 
@@ -778,8 +861,11 @@ void ReportRace(ThreadState *thr, RawShadow *shadow_mem, Shadow cur, Shadow old,
   if (IsFiredSuppression(ctx, rep_typ, traces[1]))
     return;
 
-  if (HandleRacyStacks(thr, traces))
+  if (HandleRacyStacks(thr, traces)) {
+    ctx->racy_filter.Add(filter_key);
+    atomic_fetch_add(&ctx->racy_filter.dropped, 1, memory_order_relaxed);
     return;
+  }
 
   // If any of the accesses has a tag, treat this as an "external" race.
   uptr tag = kExternalTagNone;
@@ -821,6 +907,8 @@ void ReportRace(ThreadState *thr, RawShadow *shadow_mem, Shadow cur, Shadow old,
     rep.AddSleep(thr->last_sleep_stack_id);
 #endif
   OutputReport(thr, rep);
+  if (filter_key)
+    ctx->racy_filter.Add(filter_key);
 }
 
 void PrintCurrentStack(ThreadState *thr, uptr pc) {
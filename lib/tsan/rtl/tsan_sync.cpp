@@ -206,10 +206,14 @@ SyncVar *MetaMap::GetSync(ThreadState *thr, uptr pc, uptr addr, bool create,
   DCHECK(!create || thr->slot_locked);
   u32 *meta = MemToMeta(addr);
   u32 idx0 = *meta;
+  // Part of the list that is already known to not contain addr.
+  // New objects are only ever prepended to the list, so after a failed CAS
+  // we only need to look at the newly added prefix.
+  u32 scanned = 0;
   u32 myidx = 0;
   SyncVar *mys = nullptr;
   for (;;) {
-    for (u32 idx = idx0; idx && !(idx & kFlagBlock);) {
+    for (u32 idx = idx0; idx && idx != scanned && !(idx & kFlagBlock);) {
       DCHECK(idx & kFlagSync);
       SyncVar * s = sync_alloc_.Map(idx & ~kFlagMask);
       if (LIKELY(s->addr == addr)) {
@@ -224,6 +228,7 @@ SyncVar *MetaMap::GetSync(ThreadState *thr, uptr pc, uptr addr, bool create,
     if (!create)
       return nullptr;
     if (UNLIKELY(*meta != idx0)) {
+      scanned = idx0;
       idx0 = *meta;
       continue;
     }
@@ -234,10 +239,12 @@ SyncVar *MetaMap::GetSync(ThreadState *thr, uptr pc, uptr addr, bool create,
       mys->Init(thr, pc, addr, save_stack);
     }
     mys->next = idx0;
+    u32 cmp = idx0;
     if (atomic_compare_exchange_strong((atomic_uint32_t*)meta, &idx0,
         myidx | kFlagSync, memory_order_release)) {
       return mys;
     }
+    scanned = cmp;
   }
 }
 
@@ -258,8 +265,12 @@ void MetaMap::MoveMemory(uptr src, uptr dst, uptr sz) {
     inc = -1;
   }
   for (; src_meta != src_meta_end; src_meta += inc, dst_meta += inc) {
-    CHECK_EQ(*dst_meta, 0);
     u32 idx = *src_meta;
+    // Don't touch dst meta for empty cells -- the heap can be huge
+    // and most of it has no meta objects.
+    if (idx == 0)
+      continue;
+    CHECK_EQ(*dst_meta, 0);
     *src_meta = 0;
     *dst_meta = idx;
     // Patch the addresses in sync objects.
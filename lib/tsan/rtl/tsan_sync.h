@@ -17,6 +17,7 @@
 #include "sanitizer_common/sanitizer_deadlock_detector_interface.h"
 #include "tsan_defs.h"
 #include "tsan_dense_alloc.h"
+#include "tsan_platform.h"
 #include "tsan_shadow.h"
 #include "tsan_vector_clock.h"
 
@@ -116,6 +117,12 @@ class MetaMap {
     return GetSync(thr, pc, addr, true, save_stack);
   }
   SyncVar *GetSyncIfExists(uptr addr) {
+    // Fast path: most atomic variables that are only acquire-loaded never get
+    // a sync object, so the meta cell is either empty or holds only the heap
+    // block descriptor (which always terminates the list).
+    u32 idx = atomic_load_relaxed((atomic_uint32_t *)MemToMeta(addr));
+    if (LIKELY(idx == 0 || (idx & kFlagBlock)))
+      return nullptr;
     return GetSync(nullptr, 0, addr, false, false);
   }
 
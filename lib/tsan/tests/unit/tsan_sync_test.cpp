@@ -74,6 +74,36 @@ TEST(MetaMap, Sync) {
   m->OnProcIdle(thr->proc());
 }
 
+TEST(MetaMap, SyncList) {
+  ScopedIgnoreInterceptors ignore;
+  ThreadState *thr = cur_thread();
+  SlotLocker locker(thr);
+  MetaMap *m = &ctx->metamap;
+  // All sync objects for a single meta cell are chained in one list
+  // terminated by the heap block.
+  u64 block[1] = {};  // fake malloc block
+  uptr base = (uptr)&block[0];
+  m->AllocBlock(thr, 0, base, 1 * sizeof(u64));
+  CHECK_EQ(m->GetSyncIfExists(base), (SyncVar *)0);
+  SyncVar *s[sizeof(u64)];
+  for (uptr i = 0; i < sizeof(u64); i++) {
+    s[i] = m->GetSyncOrCreate(thr, 0, base + i, false);
+    CHECK_NE(s[i], (SyncVar *)0);
+    CHECK_EQ(s[i]->addr, base + i);
+  }
+  for (uptr i = 0; i < sizeof(u64); i++) {
+    CHECK_EQ(m->GetSyncIfExists(base + i), s[i]);
+    CHECK_EQ(m->GetSyncOrCreate(thr, 0, base + i, false), s[i]);
+  }
+  MBlock *mb = m->GetBlock(base);
+  CHECK_NE(mb, (MBlock *)0);
+  CHECK_EQ(mb->siz, 1 * sizeof(u64));
+  m->FreeBlock(thr->proc(), base, true);
+  for (uptr i = 0; i < sizeof(u64); i++)
+    CHECK_EQ(m->GetSyncIfExists(base + i), (SyncVar *)0);
+  m->OnProcIdle(thr->proc());
+}
+
 TEST(MetaMap, MoveMemory) {
   ScopedIgnoreInterceptors ignore;
   ThreadState *thr = cur_thread();
@@ -67,6 +67,16 @@ struct ThreadArray {
   operator ThreadState *() { return threads[0]; }
 };
 
+// Like TryTraceMemoryAccess, but switches to a new trace part if needed
+// (e.g. for the first event of a thread).
+static void TraceMemoryAccess(ThreadState *thr, uptr pc, uptr addr, uptr size,
+                              AccessType typ) {
+  if (TryTraceMemoryAccess(thr, pc, addr, size, typ))
+    return;
+  TraceSwitchPart(thr);
+  CHECK(TryTraceMemoryAccess(thr, pc, addr, size, typ));
+}
+
 TRACE_TEST(Trace, RestoreAccess) {
   // A basic test with some function entry/exit events,
   // some mutex lock/unlock events and some other distracting
@@ -243,6 +253,80 @@ TRACE_TEST(Trace, MultiPart) {
   CHECK_EQ(mset.Get(1).count, 1);
 }
 
+TRACE_TEST(Trace, MultiPartEpochs) {
+  // Check that replay starts from the right part: a part that starts
+  // at the target epoch can still be preceded by events of that epoch.
+  ThreadArray<1> thr;
+  FuncEntry(thr, 0x1000);
+  TraceMemoryAccess(thr, 0x2000, 0x3000, 8, kAccessRead);
+  Epoch epoch0 = thr->fast_state.epoch();
+  const uptr kEvents = sizeof(TracePart) / sizeof(Event);
+  for (uptr i = 0; i < kEvents; i++) TraceMutexUnlock(thr, 0x5000);
+  {
+    SlotLocker locker(thr);
+    IncrementEpoch(thr);
+  }
+  for (uptr i = 0; i < kEvents / 2; i++) TraceMutexUnlock(thr, 0x5000);
+  CHECK(TryTraceMemoryAccess(thr, 0x2001, 0x3008, 8, kAccessRead));
+  Epoch epoch1 = thr->fast_state.epoch();
+  CHECK_GT(thr->tctx->trace.parts.Size(), 1);
+  Lock slot_lock(&ctx->slots[static_cast<uptr>(thr->fast_state.sid())].mtx);
+  ThreadRegistryLock lock1(&ctx->thread_registry);
+  Lock lock2(&ctx->slot_mtx);
+  Tid tid = kInvalidTid;
+  VarSizeStackTrace stk;
+  MutexSet mset;
+  uptr tag = kExternalTagNone;
+  bool res =
+      RestoreStack(EventType::kAccessExt, thr->fast_state.sid(), epoch0, 0x3000,
+                   8, kAccessRead, &tid, &stk, &mset, &tag);
+  CHECK(res);
+  CHECK_EQ(stk.size, 2);
+  CHECK_EQ(stk.trace[0], 0x1000);
+  CHECK_EQ(stk.trace[1], 0x2000);
+  res = RestoreStack(EventType::kAccessExt, thr->fast_state.sid(), epoch1,
+                     0x3008, 8, kAccessRead, &tid, &stk, &mset, &tag);
+  CHECK(res);
+  CHECK_EQ(stk.size, 2);
+  CHECK_EQ(stk.trace[0], 0x1000);
+  CHECK_EQ(stk.trace[1], 0x2001);
+}
+
+TRACE_TEST(Trace, ElideEmptyFunc) {
+  // Function entry events are written only before the next event,
+  // so function calls without events don't get into the trace.
+  ThreadArray<1> thr;
+  FuncEntry(thr, 0x1000);
+  TraceMemoryAccess(thr, 0x2000, 0x3000, 8, kAccessRead);
+  uptr pos = atomic_load_relaxed(&thr->trace_pos);
+  FuncEntry(thr, 0x1001);
+  FuncEntry(thr, 0x1003);
+  FuncExit(thr);
+  FuncExit(thr);
+  CHECK_EQ(atomic_load_relaxed(&thr->trace_pos), pos + 2 * sizeof(Event));
+  pos = atomic_load_relaxed(&thr->trace_pos);
+  FuncEntry(thr, 0x1002);
+  CHECK_EQ(atomic_load_relaxed(&thr->trace_pos), pos);
+  CHECK(TryTraceMemoryAccess(thr, 0x2001, 0x3008, 8, kAccessRead));
+  FuncExit(thr);
+  CHECK_EQ(atomic_load_relaxed(&thr->trace_pos), pos + 3 * sizeof(Event));
+  Lock slot_lock(&ctx->slots[static_cast<uptr>(thr->fast_state.sid())].mtx);
+  ThreadRegistryLock lock1(&ctx->thread_registry);
+  Lock lock2(&ctx->slot_mtx);
+  Tid tid = kInvalidTid;
+  VarSizeStackTrace stk;
+  MutexSet mset;
+  uptr tag = kExternalTagNone;
+  bool res = RestoreStack(EventType::kAccessExt, thr->fast_state.sid(),
+                          thr->fast_state.epoch(), 0x3008, 8, kAccessRead,
+                          &tid, &stk, &mset, &tag);
+  CHECK(res);
+  CHECK_EQ(stk.size, 3);
+  CHECK_EQ(stk.trace[0], 0x1000);
+  CHECK_EQ(stk.trace[1], 0x1002);
+  CHECK_EQ(stk.trace[2], 0x2001);
+}
+
 TRACE_TEST(Trace, DeepSwitch) {
   ThreadArray<1> thr;
   for (int i = 0; i < 2000; i++) {
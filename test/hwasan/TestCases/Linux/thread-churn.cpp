@@ -0,0 +1,34 @@
+// Checks that the thread stats balance out when several threads churn through
+// short-lived threads at once.
+// RUN: %clangxx_hwasan %s -pthread -O2 -o %t
+// RUN: %run %t 2>&1 | FileCheck %s
+
+#include <thread>
+#include <vector>
+
+#include <stdio.h>
+
+#include <sanitizer/hwasan_interface.h>
+
+constexpr int kSpawners = 8;
+constexpr int kIterations = 200;
+
+void Spawner() {
+  for (int i = 0; i < kIterations; ++i)
+    std::thread([]() {}).join();
+}
+
+int main() {
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kSpawners; ++i)
+    threads.emplace_back(Spawner);
+  for (auto &t : threads)
+    t.join();
+
+  __hwasan_print_memory_usage();
+  // CHECK: HWASAN pid: {{.*}} threads: 1 stacks:
+  fprintf(stderr, "DONE\n");
+  return 0;
+}
+
+// CHECK: DONE
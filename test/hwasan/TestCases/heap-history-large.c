@@ -0,0 +1,29 @@
+// Checks that the heap history keeps the exact size of large allocations, so
+// a use-after-free far into a large chunk is still attributed to it.
+// RUN: %clang_hwasan -O0 %s -o %t && not %run %t 2>&1 | FileCheck %s
+
+// REQUIRES: stable-runtime
+
+#include <sanitizer/hwasan_interface.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+
+enum { kSize = (40 << 20) + 5 };
+
+int main() {
+  __hwasan_enable_allocator_tagging();
+  char *volatile p = (char *)malloc(kSize);
+  free(p);
+  // The chunk is unmapped on free. Map it again with a zero tag, so that the
+  // access through p is a tag mismatch instead of a SEGV.
+  void *untagged = __hwasan_tag_pointer(p, 0);
+  if (mmap(untagged, kSize, PROT_READ | PROT_WRITE,
+           MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0) != untagged)
+    return 0;
+  return p[kSize - 1];
+  // CHECK: ERROR: HWAddressSanitizer: tag-mismatch
+  // CHECK: Cause: use-after-free
+  // CHECK: is located 41943044 bytes inside of 41943045-byte region
+  // CHECK: freed by thread {{.*}} here:
+  // CHECK: previously allocated here:
+}
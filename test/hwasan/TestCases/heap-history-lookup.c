@@ -0,0 +1,26 @@
+// Checks use-after-free attribution when the freed chunk's record is the
+// oldest one in a deep heap history.
+// RUN: %clang_hwasan -O0 %s -o %t -fsanitize-recover=hwaddress
+// RUN: %env_hwasan_opts=halt_on_error=0:heap_history_size=16383 %run %t 2>&1 | FileCheck %s
+
+// REQUIRES: stable-runtime
+
+#include <sanitizer/hwasan_interface.h>
+#include <stdlib.h>
+
+enum { kAllocs = 16000 };
+
+void *p[kAllocs];
+
+int main() {
+  __hwasan_enable_allocator_tagging();
+  for (int i = 0; i < kAllocs; i++)
+    p[i] = malloc(16 + i % 100);
+  for (int i = 0; i < kAllocs; i++)
+    free(p[i]);
+  // The oldest record is the last one found by the lookup.
+  *(volatile char *)p[0] = 0;
+  // CHECK: Cause: use-after-free
+  // CHECK: located 0 bytes inside of 16-byte region
+  // CHECK: hwasan_dev_note_heap_rb_distance: 16000 16383
+}
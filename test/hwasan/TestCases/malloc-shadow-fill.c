@@ -0,0 +1,39 @@
+// Checks that the whole chunk's shadow holds the pointer tag, for chunk shadows
+// of every length modulo the shadow word size.
+// RUN: %clang_hwasan -O2 %s -o %t
+// RUN: %run %t 2>&1 | FileCheck %s
+// RUN: %env_hwasan_opts=tag_in_free=0 %run %t 2>&1 | FileCheck %s
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sanitizer/hwasan_interface.h>
+
+enum { kWindow = 64, kIters = 2000 };
+
+int main() {
+  __hwasan_enable_allocator_tagging();
+  void *chunks[kWindow] = {0};
+  for (size_t size = 16; size <= (256 << 10); size *= 4) {
+    for (int i = 0; i < kIters; i++) {
+      int idx = i % kWindow;
+      free(chunks[idx]);
+      // Granule multiples only: the last granule of other sizes holds the
+      // short granule size instead of the tag.
+      size_t n = size + 16 * (i % 9);
+      chunks[idx] = malloc(n);
+      intptr_t bad = __hwasan_test_shadow(chunks[idx], n);
+      if (bad != -1)
+        fprintf(stderr, "size %zu: bad shadow at offset %zd\n", n, bad);
+      memset(chunks[idx], 0, n);
+    }
+  }
+  for (int i = 0; i < kWindow; i++)
+    free(chunks[i]);
+  fprintf(stderr, "DONE\n");
+  return 0;
+}
+
+// CHECK-NOT: bad shadow
+// CHECK: DONE
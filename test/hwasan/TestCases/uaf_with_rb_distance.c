@@ -23,5 +23,5 @@ int main(int argc, char **argv) {
   *(int*)p[distance] = 0;
 }
 
-// D10: hwasan_dev_note_heap_rb_distance: 90 1023
-// D42: hwasan_dev_note_heap_rb_distance: 58 1023
+// D10: hwasan_dev_note_heap_rb_distance: 90 1535
+// D42: hwasan_dev_note_heap_rb_distance: 58 1535
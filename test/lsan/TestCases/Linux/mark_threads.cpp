@@ -0,0 +1,53 @@
+// Test that marking with several threads finds the same leaks as marking with
+// one.
+// RUN: %clangxx_lsan -O2 %s -o %t
+// RUN: %env_lsan_opts=use_stacks=0:use_registers=0:mark_threads=1 %run %t 2>&1 | FileCheck %s
+// RUN: %env_lsan_opts=use_stacks=0:use_registers=0:mark_threads=4 %run %t 2>&1 | FileCheck %s
+// RUN: %env_lsan_opts=use_stacks=0:use_registers=0:mark_threads=0 %run %t 2>&1 | FileCheck %s
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sanitizer/lsan_interface.h>
+
+struct Node {
+  Node *left;
+  Node *right;
+};
+
+const int kLiveDepth = 20;
+const int kLeakedNodes = 1000;
+
+Node *live;
+Node *leaked;
+
+static Node *MakeTree(int depth) {
+  if (depth == 0)
+    return nullptr;
+  Node *n = (Node *)malloc(sizeof(Node));
+  n->left = MakeTree(depth - 1);
+  n->right = MakeTree(depth - 1);
+  return n;
+}
+
+int main() {
+  live = MakeTree(kLiveDepth);
+  // A list, so that all but the head are only reachable from leaked memory.
+  for (int i = 0; i < kLeakedNodes; i++) {
+    Node *n = (Node *)malloc(sizeof(Node));
+    n->left = leaked;
+    n->right = nullptr;
+    leaked = n;
+  }
+
+  assert(__lsan_do_recoverable_leak_check() == 0);
+
+  leaked = nullptr;
+  assert(__lsan_do_recoverable_leak_check() == 1);
+  fprintf(stderr, "DONE\n");
+  _exit(0);
+}
+
+// CHECK: SUMMARY: {{(Leak|Address)}}Sanitizer: {{[0-9]+}} byte(s) leaked in 1000 allocation(s)
+// CHECK: DONE
@@ -0,0 +1,36 @@
+// Test periodic leak checks from the background thread. A chunk that is only
+// reachable through memory written after the previous check must not be
+// reported.
+// Incremental checks are tested in periodic_leak_check_incremental.cpp.
+// RUN: %clangxx_lsan %s -o %t
+// RUN: %env_lsan_opts=use_stacks=0:use_registers=0:leak_check_interval_ms=20 %run %t 2>&1 | FileCheck %s
+// RUN: %env_lsan_opts=use_stacks=0:use_registers=0:leak_check_interval_ms=20:incremental_leak_check=0:verbosity=1 %run %t 2>&1 | FileCheck %s --check-prefixes=CHECK,FULL
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+void **holder;
+
+int main() {
+  holder = (void **)malloc(4096);
+  for (int i = 0; i < 512; i++)
+    holder[i] = nullptr;
+  // Let a few checks mark |holder| as reachable.
+  usleep(200 * 1000);
+
+  holder[100] = malloc(1000);
+  void *volatile leak = malloc(1337);
+  leak = nullptr;
+  fprintf(stderr, "Leaked.\n");
+  usleep(300 * 1000);
+  fprintf(stderr, "DONE\n");
+  _exit(0);
+}
+
+// FULL: periodic leak checks every 20 ms (full)
+// CHECK: Leaked.
+// CHECK-NOT: 2337 byte(s)
+// CHECK: SUMMARY: {{(Leak|Address)}}Sanitizer: 1337 byte(s) leaked in 1 allocation(s)
+// CHECK-NOT: 2337 byte(s)
+// CHECK: DONE
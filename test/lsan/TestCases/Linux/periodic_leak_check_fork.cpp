@@ -0,0 +1,38 @@
+// Test that a child forked while a periodic leak check is running can do its
+// own leak check at exit.
+// RUN: %clangxx_lsan %s -o %t
+// RUN: %env_lsan_opts=leak_check_interval_ms=1 %run %t 2>&1 | FileCheck %s
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+void *chunks[10000];
+
+int main() {
+  // Give the periodic checks some work, so that forks hit them.
+  for (int i = 0; i < 10000; i++)
+    chunks[i] = malloc(64);
+  for (int i = 0; i < 100; i++) {
+    pid_t pid = fork();
+    assert(pid >= 0);
+    if (pid == 0) {
+      // A deadlocked leak check is killed by SIGALRM.
+      alarm(10);
+      exit(0);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      fprintf(stderr, "Child %d failed.\n", i);
+      return 1;
+    }
+  }
+  fprintf(stderr, "DONE\n");
+  return 0;
+}
+
+// CHECK-NOT: failed
+// CHECK: DONE
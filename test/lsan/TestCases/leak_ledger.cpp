@@ -0,0 +1,65 @@
+// Test that recoverable leak checks only report and count new and growing
+// leaks, and print machine-readable leak deltas.
+// RUN: %clangxx_lsan %s -o %t
+// RUN: %env_lsan_opts=use_stacks=0:use_registers=0:report_new_leaks_only=1:print_leak_deltas=1 %run %t 2>&1 | FileCheck %s
+//
+// UNSUPPORTED: darwin
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sanitizer/lsan_interface.h>
+
+__attribute__((noinline)) void LeakA() {
+  void *volatile p = malloc(100);
+  p = nullptr;
+}
+
+__attribute__((noinline)) void LeakB() {
+  void *volatile p = malloc(37);
+  p = nullptr;
+}
+
+int main() {
+  for (int i = 0; i < 3; i++) {
+    if (i != 1)
+      LeakA();
+    fprintf(stderr, "Check %d\n", i);
+    fprintf(stderr, "Result %d\n", __lsan_do_recoverable_leak_check());
+  }
+  LeakB();
+  fprintf(stderr, "Check 3\n");
+  fprintf(stderr, "Result %d\n", __lsan_do_recoverable_leak_check());
+  _exit(0);
+}
+
+// CHECK: Check 0
+// CHECK: Direct leak of 100 byte(s) in 1 object(s)
+// CHECK: LEAK_DELTA check=1 stack_id={{[0-9]+}} kind=direct objects=1 bytes=100 delta_objects=1 delta_bytes=100
+// CHECK: LEAK_TOTAL check=1 objects=1 bytes=100 delta_objects=1 delta_bytes=100
+// CHECK: SUMMARY: {{.*}}Sanitizer: 100 byte(s) leaked in 1 allocation(s).
+// CHECK: Result 1
+
+// CHECK: Check 1
+// CHECK-NOT: leak of
+// CHECK-NOT: LEAK_DELTA
+// CHECK: LEAK_TOTAL check=2 objects=1 bytes=100 delta_objects=0 delta_bytes=0
+// CHECK-NOT: SUMMARY
+// CHECK: Result 0
+
+// CHECK: Check 2
+// CHECK: Direct leak of 200 byte(s) in 2 object(s)
+// CHECK-NEXT: Grew by 100 byte(s) in 1 object(s) since the previous check.
+// CHECK: LEAK_TOTAL check=3 objects=2 bytes=200 delta_objects=1 delta_bytes=100
+// CHECK: SUMMARY: {{.*}}Sanitizer: 200 byte(s) leaked in 2 allocation(s).
+// CHECK: Result 1
+
+// CHECK: Check 3
+// CHECK-NOT: leak of 200
+// CHECK: Direct leak of 37 byte(s) in 1 object(s)
+// CHECK-NOT: leak of 200
+// CHECK: LEAK_DELTA check=4 stack_id={{[0-9]+}} kind=direct objects=1 bytes=37 delta_objects=1 delta_bytes=37
+// CHECK: LEAK_TOTAL check=4 objects=3 bytes=237 delta_objects=1 delta_bytes=37
+// The unchanged leak of LeakA is not counted.
+// CHECK: SUMMARY: {{.*}}Sanitizer: 37 byte(s) leaked in 1 allocation(s).
+// CHECK: Result 1
@@ -0,0 +1,40 @@
+// Test that a heap pointer hidden among many words that are not heap pointers
+// is still found, both in globals and in a heap block.
+// RUN: %clangxx_lsan -O2 %s -o %t
+// RUN: %env_lsan_opts=use_stacks=0:use_registers=0 %run %t 2>&1 | FileCheck %s
+//
+// UNSUPPORTED: darwin
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sanitizer/lsan_interface.h>
+
+const size_t kWords = 1 << 20;
+
+uintptr_t globals[kWords];
+
+int main() {
+  // Small integers and high addresses, like counters and kernel pointers.
+  for (size_t i = 0; i < kWords; i++)
+    globals[i] = i % 2 ? i : ~(uintptr_t)i;
+  // A heap block of the same kind of data, reachable from the globals.
+  uintptr_t *heap = (uintptr_t *)malloc(kWords * sizeof(uintptr_t));
+  for (size_t i = 0; i < kWords; i++)
+    heap[i] = globals[i];
+  globals[kWords / 2 + 3] = (uintptr_t)heap;
+  // Only reachable through a word in the middle of the heap block.
+  heap[kWords / 3 + 5] = (uintptr_t)malloc(1337);
+
+  assert(__lsan_do_recoverable_leak_check() == 0);
+
+  heap[kWords / 3 + 5] = 0;
+  assert(__lsan_do_recoverable_leak_check() == 1);
+  fprintf(stderr, "DONE\n");
+  _exit(0);
+}
+
+// CHECK: SUMMARY: {{(Leak|Address)}}Sanitizer: 1337 byte(s) leaked in 1 allocation(s)
+// CHECK: DONE
@@ -54,6 +54,34 @@ config.substitutions.append(('%env_lsan_opts=',
 if lit.util.which('strace'):
   config.available_features.add('strace')
 
+# Incremental periodic leak checks need soft-dirty page tracking in the kernel
+# (CONFIG_MEM_SOFT_DIRTY). Probe it the same way the runtime does: clear the
+# soft-dirty bits, then check that a write to a page sets its bit again.
+def soft_dirty_supported():
+  if config.host_os != 'Linux':
+    return False
+  import ctypes, mmap, struct
+  page_size = mmap.PAGESIZE
+  try:
+    buf = mmap.mmap(-1, page_size)
+    addr = ctypes.addressof(ctypes.c_char.from_buffer(buf))
+    def is_soft_dirty():
+      with open('/proc/self/pagemap', 'rb') as f:
+        f.seek(addr // page_size * 8)
+        return bool(struct.unpack('<Q', f.read(8))[0] & (1 << 55))
+    buf[0] = 1
+    with open('/proc/self/clear_refs', 'w') as f:
+      f.write('4')
+    if is_soft_dirty():
+      return False
+    buf[0] = 2
+    return is_soft_dirty()
+  except (OSError, ValueError):
+    return False
+
+if soft_dirty_supported():
+  config.available_features.add('soft-dirty')
+
 clang_cflags = ["-O0", config.target_cflags] + config.debug_info_flags
 if config.android:
   clang_cflags = clang_cflags + ["-fno-emulated-tls"]
@@ -0,0 +1,98 @@
+// RUN: %clangxx_tsan %s -o %t
+// RUN: %run %t 2>&1 | FileCheck %s
+// RUN: %env_tsan_opts=io_sync_batch=1 %run %t 2>&1 | FileCheck %s
+
+// TCP ping-pong between pairs of threads that run epoll loops over loopback.
+// Unlike socketpair/pipe fds, these share one sync object process-wide.
+// Each iteration exchanges a burst of small messages, so the run time
+// is dominated by fd synchronization in send/recv interceptors.
+// Compare with io_sync_batch=1 to see the effect of skipping acquires.
+
+#include "../bench.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+
+const int kMsgs = 16;
+const int kMsgSize = 16;
+int *socks;
+
+static void recv_all(int epfd, int fd) {
+  char buf[kMsgs * kMsgSize];
+  int got = 0;
+  while (got < kMsgs * kMsgSize) {
+    epoll_event ev;
+    if (epoll_wait(epfd, &ev, 1, -1) != 1)
+      exit(printf("epoll_wait failed: %d\n", errno));
+    for (;;) {
+      int n = recv(fd, buf, kMsgSize, MSG_DONTWAIT);
+      if (n <= 0)
+        break;
+      got += n;
+    }
+  }
+}
+
+static void send_all(int fd) {
+  char buf[kMsgSize] = {};
+  for (int i = 0; i < kMsgs; i++) {
+    if (send(fd, buf, sizeof(buf), 0) != sizeof(buf))
+      exit(printf("send failed: %d\n", errno));
+  }
+}
+
+void thread(int tid) {
+  int fd = socks[tid];
+  int epfd = epoll_create1(0);
+  epoll_event ev = {};
+  ev.events = EPOLLIN;
+  if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev))
+    exit(printf("epoll_ctl failed: %d\n", errno));
+  for (int i = 0; i < bench_niter; i++) {
+    if (tid % 2 == 0) {
+      send_all(fd);
+      recv_all(epfd, fd);
+    } else {
+      recv_all(epfd, fd);
+      send_all(fd);
+    }
+  }
+  close(epfd);
+}
+
+// Creates a connected pair of loopback TCP sockets.
+static void tcp_pair(int *sv) {
+  sockaddr_in addr = {};
+  socklen_t addrlen = sizeof(addr);
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  int s = socket(AF_INET, SOCK_STREAM, 0);
+  if (s < 0 || bind(s, (sockaddr *)&addr, addrlen) ||
+      getsockname(s, (sockaddr *)&addr, &addrlen) || listen(s, 1))
+    exit(printf("listen failed: %d\n", errno));
+  sv[0] = socket(AF_INET, SOCK_STREAM, 0);
+  if (connect(sv[0], (sockaddr *)&addr, addrlen))
+    exit(printf("connect failed: %d\n", errno));
+  sv[1] = accept(s, 0, 0);
+  if (sv[1] < 0)
+    exit(printf("accept failed: %d\n", errno));
+  close(s);
+  int one = 1;
+  setsockopt(sv[0], IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  setsockopt(sv[1], IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+}
+
+void bench() {
+  socks = (int *)malloc(2 * bench_nthread * sizeof(int));
+  for (int i = 0; i < bench_nthread; i++)
+    tcp_pair(&socks[2 * i]);
+  start_thread_group(2 * bench_nthread, thread);
+  for (int i = 0; i < 2 * bench_nthread; i++)
+    close(socks[i]);
+  free(socks);
+}
+
+// CHECK: DONE
@@ -0,0 +1,68 @@
+// RUN: %clangxx_tsan -O1 %s -o %t
+// RUN: %env_tsan_opts=io_sync_batch=1 %run %t 2>&1 | FileCheck %s
+// Check that io_sync_batch does not lose synchronization between a thread
+// that runs an epoll loop and a thread that receives from it.
+#include "../test.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+
+struct sockaddr_in addr;
+socklen_t addrlen = sizeof(addr);
+int X;
+
+void *ClientThread(void *x) {
+  int epfd = epoll_create1(0);
+  epoll_event ev;
+  epoll_wait(epfd, &ev, 1, 0);
+  int c = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  if (connect(c, (struct sockaddr *)&addr, addrlen)) {
+    perror("connect");
+    exit(1);
+  }
+  // Acquire the socket sync object, as an event loop does, before the write
+  // that the send must publish.
+  char buf;
+  recv(c, &buf, 1, MSG_DONTWAIT);
+  X = 42;
+  if (send(c, "a", 1, 0) != 1) {
+    perror("send");
+    exit(1);
+  }
+  // Stay in the loop iteration until the receiver is done.
+  barrier_wait(&barrier);
+  close(c);
+  close(epfd);
+  return NULL;
+}
+
+int main() {
+  barrier_init(&barrier, 2);
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = INADDR_ANY;
+  int s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  if (s < 0) {
+    fprintf(stderr, "DONE\n");
+    return 0;
+  }
+  bind(s, (struct sockaddr *)&addr, addrlen);
+  getsockname(s, (struct sockaddr *)&addr, &addrlen);
+  listen(s, 10);
+  pthread_t t;
+  pthread_create(&t, 0, ClientThread, 0);
+  int c = accept(s, 0, 0);
+  char buf;
+  while (read(c, &buf, 1) != 1) {
+  }
+  X = 43;
+  barrier_wait(&barrier);
+  close(c);
+  close(s);
+  pthread_join(t, 0);
+  fprintf(stderr, "DONE\n");
+}
+
+// CHECK-NOT: WARNING: ThreadSanitizer: data race
+// CHECK: DONE
@@ -0,0 +1,80 @@
+// RUN: %clangxx_tsan -O1 %s -o %t
+// RUN: %run %t 2>&1 | FileCheck %s
+// RUN: %run %t 1 2>&1 | FileCheck %s
+
+// Simulates a copying GC: each cycle allocates objects with locks in one
+// semispace, then copies live objects to the other semispace and frees dead
+// ones. Mode 0 passes every region in a separate call, mode 1 passes all
+// regions in one __tsan_java_move_regions and one __tsan_java_free_regions
+// call. The benchmark version is lib/tsan/benchmarks/java_gc.cpp.
+
+#include "java.h"
+
+const jptr kHeapSize = 16 << 20;
+const jptr kObjects = 256;
+const jptr kObjectSize = 4 << 10;
+const int kCycles = 4;
+
+int main(int argc, char **argv) {
+  int mode = argc > 1 ? atoi(argv[1]) : 0;
+  jptr heap = (jptr)malloc(kHeapSize + 8) + 8;
+  __tsan_java_init(heap, kHeapSize);
+  const jptr kSpaceSize = kHeapSize / 2;
+  const jptr kStride = kSpaceSize / kObjects;
+  jptr *moves = (jptr *)malloc(kObjects * 3 * sizeof(jptr));
+  jptr *frees = (jptr *)malloc(kObjects * 2 * sizeof(jptr));
+  for (int cycle = 0; cycle < kCycles; cycle++) {
+    jptr from = heap + (cycle % 2) * kSpaceSize;
+    jptr to = heap + (1 - cycle % 2) * kSpaceSize;
+    for (jptr i = 0; i < kObjects; i++) {
+      jptr obj = from + i * kStride;
+      __tsan_java_alloc(obj, kObjectSize);
+      __tsan_java_mutex_lock(obj + 16);
+      *(int *)obj = 1;
+      __tsan_java_mutex_unlock(obj + 16);
+    }
+    jptr nmoves = 0, nfrees = 0;
+    for (jptr i = 0; i < kObjects; i++) {
+      jptr obj = from + i * kStride;
+      if (i % 2 == 0) {
+        moves[nmoves * 3] = obj;
+        moves[nmoves * 3 + 1] = to + nmoves * kObjectSize;
+        moves[nmoves * 3 + 2] = kObjectSize;
+        nmoves++;
+      } else {
+        frees[nfrees * 2] = obj;
+        frees[nfrees * 2 + 1] = kObjectSize;
+        nfrees++;
+      }
+    }
+    if (mode == 0) {
+      for (jptr i = 0; i < nmoves; i++)
+        __tsan_java_move(moves[i * 3], moves[i * 3 + 1], moves[i * 3 + 2]);
+      for (jptr i = 0; i < nfrees; i++)
+        __tsan_java_free(frees[i * 2], frees[i * 2 + 1]);
+    } else {
+      __tsan_java_move_regions(moves, nmoves);
+      __tsan_java_free_regions(frees, nfrees);
+    }
+    // Survivors are allocated at their new addresses, the old semispace
+    // is empty.
+    for (jptr i = 0; i < nmoves; i++) {
+      jptr obj = to + i * kObjectSize;
+      jptr p = obj;
+      if (__tsan_java_find(&p, obj + kObjectSize) != kObjectSize || p != obj)
+        fprintf(stderr, "object %lu not moved\n", i);
+    }
+    jptr p = from;
+    if (__tsan_java_find(&p, from + kSpaceSize))
+      fprintf(stderr, "object at %lu not freed\n", p - from);
+    // All survivors die before the next cycle.
+    __tsan_java_free(to, nmoves * kObjectSize);
+  }
+  fprintf(stderr, "DONE\n");
+  return __tsan_java_fini();
+}
+
+// CHECK-NOT: WARNING: ThreadSanitizer
+// CHECK-NOT: not moved
+// CHECK-NOT: not freed
+// CHECK: DONE
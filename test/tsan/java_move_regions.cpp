@@ -0,0 +1,52 @@
+// RUN: %clangxx_tsan -O1 %s -o %t && %run %t 2>&1 | FileCheck %s
+#include "java.h"
+
+// Two objects with locks are moved by one __tsan_java_move_regions call
+// and freed by one __tsan_java_free_regions call.
+
+const int kBlockSize = 64;
+const int kMove = 1024;
+jptr varaddr[2];
+jptr lockaddr[2];
+
+void *Thread(void *p) {
+  barrier_wait(&barrier);
+  for (int i = 0; i < 2; i++) {
+    __tsan_java_mutex_lock(lockaddr[i] + kMove);
+    *(int*)(varaddr[i] + kMove) = 42;
+    __tsan_java_mutex_unlock(lockaddr[i] + kMove);
+  }
+  return 0;
+}
+
+int main() {
+  barrier_init(&barrier, 2);
+  int const kHeapSize = 1024 * 1024;
+  jptr jheap = (jptr)malloc(kHeapSize + 8) + 8;
+  __tsan_java_init(jheap, kHeapSize);
+  for (int i = 0; i < 2; i++) {
+    varaddr[i] = jheap + 2 * i * kBlockSize;
+    lockaddr[i] = varaddr[i] + 46;
+    __tsan_java_alloc(varaddr[i], kBlockSize);
+  }
+  pthread_t th;
+  pthread_create(&th, 0, Thread, 0);
+  for (int i = 0; i < 2; i++) {
+    __tsan_java_mutex_lock(lockaddr[i]);
+    *(int*)varaddr[i] = 43;
+    __tsan_java_mutex_unlock(lockaddr[i]);
+  }
+  jptr moves[] = {varaddr[0], varaddr[0] + kMove, kBlockSize,
+                  varaddr[1], varaddr[1] + kMove, kBlockSize};
+  __tsan_java_move_regions(moves, 2);
+  barrier_wait(&barrier);
+  pthread_join(th, 0);
+  jptr frees[] = {varaddr[0] + kMove, kBlockSize,
+                  varaddr[1] + kMove, kBlockSize};
+  __tsan_java_free_regions(frees, 2);
+  fprintf(stderr, "DONE\n");
+  return __tsan_java_fini();
+}
+
+// CHECK-NOT: WARNING: ThreadSanitizer: data race
+// CHECK: DONE
@@ -0,0 +1,30 @@
+// RUN: %clangxx_tsan -O1 %s -o %t && %deflake %env_tsan_opts=verbosity=1 %run %t 2>&1 | FileCheck %s
+// Check that the same race on many elements of an array is reported once
+// and the duplicates are dropped by the racy filter.
+#include "test.h"
+
+const int kSize = 1000;
+long Data[kSize];
+
+void *Thread(void *x) {
+  barrier_wait(&barrier);
+  for (int i = 0; i < kSize; i++)
+    Data[i] = i;
+  return NULL;
+}
+
+int main() {
+  barrier_init(&barrier, 2);
+  pthread_t t;
+  pthread_create(&t, NULL, Thread, NULL);
+  for (int i = 0; i < kSize; i++)
+    Data[i] = i;
+  barrier_wait(&barrier);
+  pthread_join(t, NULL);
+  return 0;
+}
+
+// CHECK: WARNING: ThreadSanitizer: data race
+// CHECK-NOT: WARNING: ThreadSanitizer: data race
+// CHECK: ThreadSanitizer: reported 1 warnings
+// CHECK: ThreadSanitizer: dropped {{[1-9][0-9]*}} duplicate race(s)
@@ -0,0 +1,41 @@
+// RUN: %clangxx_tsan -O1 %s -o %t && %deflake %run %t 2>&1 | FileCheck %s
+// Check that races of the same stack against two different pcs of another
+// thread in the same epoch are both reported. The previous accesses have
+// equal shadow values (same thread, epoch, offset, size and type), only
+// their pcs differ.
+#include "test.h"
+
+long X, Y;
+
+__attribute__((noinline)) void WriteX() { X = 1; }
+
+__attribute__((noinline)) void WriteY() { Y = 1; }
+
+__attribute__((noinline)) void Read(long *p) { (void)*(volatile long *)p; }
+
+void *Thread(void *x) {
+  WriteX();
+  WriteY();
+  barrier_wait(&barrier);
+  return NULL;
+}
+
+int main() {
+  barrier_init(&barrier, 2);
+  pthread_t t;
+  pthread_create(&t, NULL, Thread, NULL);
+  barrier_wait(&barrier);
+  // Both reads must come from the same call site, so don't unroll.
+  long *ptrs[2] = {&X, &Y};
+  volatile int n = 2;
+  for (int i = 0; i < n; i++)
+    Read(ptrs[i]);
+  pthread_join(t, NULL);
+  return 0;
+}
+
+// CHECK: WARNING: ThreadSanitizer: data race
+// CHECK: #0 WriteX
+// CHECK: WARNING: ThreadSanitizer: data race
+// CHECK: #0 WriteY
+// CHECK: ThreadSanitizer: reported 2 warnings